@@ -11,6 +11,8 @@
 
 static ocl_device_t ocl_devices[32]; // up to 32 GPUs supported
 
+static mutex_t ocl_mutex; // guards process wide state shared by contexts
+
 enum { KB = 1024, MB = 1024 * KB, GB = 1024 * MB };
 
 #define call(f) do { /* fail fast OpenCL API call */           \
@@ -32,8 +34,19 @@ static void ocl_error_notify(const char * errinfo,
 
 static void* ocl_create_queue(ocl_context_t* c, bool profiling);
 
+static void ocl_profiler_start(ocl_profiler_t* pr);
+static void ocl_profiler_stop(ocl_profiler_t* pr);
+static void ocl_profiler_forget(cl_kernel k);
+static void ocl_profiler_push(ocl_context_t* c, cl_kernel k, cl_event e,
+    double user);
+
+static bool ocl_is_profiled(const ocl_context_t* c) { // by ocl_profiler_t
+    return c->ov != null && c->ov->profiler != null && c->graph == null;
+}
+
 static bool ocl_is_profiling(const ocl_context_t* c) {
-    const bool profiling = c->ov != null && c->ov->max_profiling_count > 0;
+    const bool profiling = c->ov != null && c->ov->max_profiling_count > 0 &&
+                           c->graph == null; // recorded commands have no events
     if (profiling) { fatal_if(c->ov->profiling == null, "need array"); }
     return profiling;
 }
@@ -49,10 +62,14 @@ static ocl_context_t ocl_open(int32_t ix, ocl_override_t* ov) {
     cl_device_id id = (cl_device_id)d->id;
     c.ov = ov;
     c.ix = ix;
+    c.graph = null;
     /* user_data: null will be passed to notify() */
     c.c = clCreateContext(properties, 1, &id, ocl_error_notify, null, &r);
     not_null(c.c, r);
-    c.q = ocl_create_queue(&c, ocl.is_profiling(&c));
+    c.q = ocl_create_queue(&c, ocl.is_profiling(&c) || ocl_is_profiled(&c));
+    if (ov != null && ov->profiler != null) {
+        ocl_profiler_start(ov->profiler);
+    }
     if (ov != null) {
         ov->max_groups_restore = d->max_groups;
         ov->max_items_restore  = d->max_items[0];
@@ -66,6 +83,13 @@ static ocl_context_t ocl_open(int32_t ix, ocl_override_t* ov) {
     return c;
 }
 
+static ocl_context_t ocl_fork(const ocl_context_t* c) {
+    ocl_context_t f = { .ix = c->ix, .c = c->c, .ov = null, .graph = null };
+    call(clRetainContext((cl_context)c->c)); // released by ocl_close()
+    f.q = ocl_create_queue(&f, false);
+    return f;
+}
+
 static void* ocl_create_queue(ocl_context_t* c, bool profiling) {
     cl_context ctx = c->c;
     cl_device_id device_id = (cl_device_id)ocl.devices[c->ix].id;
@@ -101,12 +125,56 @@ static ocl_memory_t ocl_allocate(ocl_context_t* c, int access, size_t bytes) {
     return (ocl_memory_t)m;
 }
 
+// Zero-copy wrapping requires page aligned address (and on Intel size
+// multiple of 64 bytes) otherwise driver silently allocates and copies.
+
+enum { ocl_page_size = 4096 };
+
+static ocl_memory_t ocl_wrap(ocl_context_t* c, int access, void* data,
+        size_t bytes) {
+    fatal_if(((uintptr_t)data & (ocl_page_size - 1)) != 0,
+             "data: %p is not page aligned", data);
+    cl_int r = 0;
+    cl_mem m = clCreateBuffer(c->c, access|CL_MEM_USE_HOST_PTR, bytes, data, &r);
+    not_null(m, r);
+    return (ocl_memory_t)m;
+}
+
+static ocl_memory_t ocl_sub_buffer(ocl_context_t* c, ocl_memory_t m,
+        size_t offset, size_t bytes) {
+    const ocl_device_t* d = &ocl.devices[c->ix];
+    fatal_if(offset % d->base_align != 0, "offset: %lld is not multiple of "
+             "CL_DEVICE_MEM_BASE_ADDR_ALIGN %lld bytes", (int64_t)offset,
+             d->base_align);
+    cl_buffer_region region = { .origin = offset, .size = bytes };
+    cl_int r = 0;
+    cl_mem s = clCreateSubBuffer((cl_mem)m, 0, CL_BUFFER_CREATE_TYPE_REGION,
+        &region, &r);
+    not_null(s, r);
+    return (ocl_memory_t)s;
+}
+
+static void* ocl_svm_alloc(ocl_context_t* c, int access, size_t bytes) {
+    const ocl_device_t* d = &ocl.devices[c->ix];
+    fatal_if(d->svm == 0, "%s does not support SVM", d->name);
+    const cl_svm_mem_flags fine = (d->svm & ocl_svm_fine_grain_buffer) != 0 ?
+        CL_MEM_SVM_FINE_GRAIN_BUFFER : 0;
+    void* p = clSVMAlloc(c->c, access|fine, bytes, 0);
+    fatal_if(p == null, "clSVMAlloc(%lld) failed", (int64_t)bytes);
+    return p;
+}
+
+static void ocl_svm_free(ocl_context_t* c, void* p) {
+    clSVMFree(c->c, p);
+}
+
 static void  ocl_deallocate(ocl_memory_t m) {
     call(clReleaseMemObject((cl_mem)m));
 }
 
 static void* ocl_map(ocl_context_t* c, int mapping, ocl_memory_t m, size_t offset,
         size_t bytes) {
+    fatal_if(c->graph != null, "only kernels can be recorded");
     cl_int r = 0;
     // blocking_map: true sync mapping
     void* a = clEnqueueMapBuffer((cl_command_queue)c->q, (cl_mem)m,
@@ -120,17 +188,187 @@ static void  ocl_unmap(ocl_context_t* c, ocl_memory_t m, const void* a) {
         0, null, null));
 }
 
-static ocl_program_t ocl_compile_program(ocl_context_t* c,
-        const char* code, size_t bytes, const char* options) {
+static void* ocl_map_async(ocl_context_t* c, int mapping, ocl_memory_t m,
+        size_t offset, size_t bytes, int count, ocl_event_t after[],
+        ocl_event_t* done) {
+    assert(count == 0 || after != null);
+    fatal_if(c->graph != null, "only kernels can be recorded");
+    cl_int r = 0;
+    cl_event completion = null;
+    void* a = clEnqueueMapBuffer((cl_command_queue)c->q, (cl_mem)m,
+        /*blocking_map: */ false, mapping, offset, bytes,
+        count, count == 0 ? null : (cl_event*)after, &completion, &r);
+    not_null(a, r);
+    *done = (ocl_event_t)completion;
+    return a;
+}
+
+static ocl_event_t ocl_unmap_async(ocl_context_t* c, ocl_memory_t m,
+        const void* a, int count, ocl_event_t after[]) {
+    assert(count == 0 || after != null);
+    cl_event completion = null;
+    call(clEnqueueUnmapMemObject((cl_command_queue)c->q, (cl_mem)m, (void*)a,
+        count, count == 0 ? null : (cl_event*)after, &completion));
+    return (ocl_event_t)completion;
+}
+
+static ocl_event_t ocl_read(ocl_context_t* c, ocl_memory_t m, size_t offset,
+        size_t bytes, void* data, int count, ocl_event_t after[]) {
+    assert(count == 0 || after != null);
+    fatal_if(c->graph != null, "only kernels can be recorded");
+    cl_event completion = null;
+    call(clEnqueueReadBuffer((cl_command_queue)c->q, (cl_mem)m,
+        /*blocking_read: */ false, offset, bytes, data,
+        count, count == 0 ? null : (cl_event*)after, &completion));
+    return (ocl_event_t)completion;
+}
+
+static ocl_event_t ocl_write(ocl_context_t* c, ocl_memory_t m, size_t offset,
+        size_t bytes, const void* data, int count, ocl_event_t after[]) {
+    assert(count == 0 || after != null);
+    fatal_if(c->graph != null, "only kernels can be recorded");
+    cl_event completion = null;
+    call(clEnqueueWriteBuffer((cl_command_queue)c->q, (cl_mem)m,
+        /*blocking_write: */ false, offset, bytes, data,
+        count, count == 0 ? null : (cl_event*)after, &completion));
+    return (ocl_event_t)completion;
+}
+
+static uint64_t ocl_fnv1a64(uint64_t h, const void* data, size_t bytes) {
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i < bytes; i++) {
+        h ^= p[i];
+        h *= 0x100000001B3ULL; // FNV prime
+    }
+    return h;
+}
+
+typedef struct ocl_cache_header_s {
+    uint64_t magic; // ocl_cache_magic
+    uint64_t key;   // FNV-1a 64 of device, driver, options and source
+    double   build; // seconds it took to build from source
+    uint64_t bytes; // of the binary that follows the header
+} ocl_cache_header_t;
+
+static const uint64_t ocl_cache_magic = 0x6E69426C636FULL; // "oclBin"
+
+typedef struct ocl_pathname_s { char s[1024]; } ocl_pathname_t; // reentrant
+
+static ocl_pathname_t ocl_cache_pathname(uint64_t key) {
+    ocl_pathname_t pn;
+    snprintf(pn.s, countof(pn.s), "%s/ocl_%016llX.bin",
+             ocl.cache.folder, (unsigned long long)key);
+    return pn;
+}
+
+static cl_program ocl_cache_load(ocl_context_t* c, uint64_t key,
+        const char* options, ocl_cache_t* stats) {
+    cl_program p = null;
+    FILE* f = fopen(ocl_cache_pathname(key).s, "rb");
+    if (f != null) {
+        double time = seconds();
+        ocl_cache_header_t h = {0};
+        void* binary = null;
+        if (fread(&h, sizeof(h), 1, f) == 1 && h.magic == ocl_cache_magic &&
+            h.key == key && h.bytes > 0 && h.bytes < (1ULL << 30)) {
+            binary = malloc(h.bytes);
+            fatal_if(binary == null);
+            if (fread(binary, 1, h.bytes, f) != h.bytes) {
+                free(binary);
+                binary = null;
+            }
+        }
+        fclose(f);
+        if (binary != null) {
+            cl_device_id device_id = (cl_device_id)ocl.devices[c->ix].id;
+            const size_t bytes = (size_t)h.bytes;
+            const unsigned char* b = (const unsigned char*)binary;
+            cl_int status = 0;
+            cl_int r = 0;
+            p = clCreateProgramWithBinary(c->c, 1, &device_id, &bytes, &b,
+                &status, &r);
+            if (r == 0 && status == 0 && p != null) {
+                r = clBuildProgram(p, 1, &device_id, options, null, null);
+            }
+            if (r != 0 || status != 0) { // stale (e.g. driver update)
+                if (p != null) { (void)clReleaseProgram(p); }
+                p = null;
+            }
+            free(binary);
+        }
+        if (p != null) {
+            time = seconds() - time;
+            stats->hits++;
+            stats->load  += time;
+            stats->saved += h.build - time;
+        } else {
+            stats->stale++;
+        }
+    }
+    return p;
+}
+
+static void ocl_cache_store(cl_program p, uint64_t key, double build) {
+    size_t bytes = 0;
+    call(clGetProgramInfo(p, CL_PROGRAM_BINARY_SIZES, sizeof(bytes),
+        &bytes, null));
+    unsigned char* binary = bytes > 0 ? (unsigned char*)malloc(bytes) : null;
+    if (binary != null) {
+        call(clGetProgramInfo(p, CL_PROGRAM_BINARIES, sizeof(binary),
+            &binary, null));
+        // Other processes may load or store the same key simultaneously:
+        // binary is written to a file unique to this process and thread
+        // and renamed over ocl_<key>.bin. Readers see either complete old
+        // or complete new file. Rename fails while a reader has the file
+        // open (Windows), new binary is dropped: next build stores it.
+        const ocl_pathname_t pn = ocl_cache_pathname(key);
+        ocl_pathname_t tmp;
+        snprintf(tmp.s, countof(tmp.s), "%s/ocl_%016llX.%08X.%08X.tmp",
+                 ocl.cache.folder, (unsigned long long)key,
+                 process_id(), thread_id());
+        FILE* f = fopen(tmp.s, "wb");
+        if (f != null) { // failure to write cache is not fatal
+            ocl_cache_header_t h = {
+                .magic = ocl_cache_magic, .key = key,
+                .build = build, .bytes = bytes
+            };
+            bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+                      fwrite(binary, 1, bytes, f) == bytes;
+            ok = fclose(f) == 0 && ok;
+            if (!ok || !file_replace(tmp.s, pn.s)) { remove(tmp.s); }
+        }
+        free(binary);
+    }
+}
+
+// builds program and accumulates cache statistics in "stats"
+// (reentrant: may be called on multiple threads simultaneously)
+
+static ocl_program_t ocl_build_program(ocl_context_t* c,
+        const char* code, size_t bytes, const char* options,
+        ocl_cache_t* stats) {
+    const ocl_device_t* d = &ocl.devices[c->ix];
+    const bool caching = ocl.cache.folder != null && ocl.cache.folder[0] != 0;
+    uint64_t key = 0xCBF29CE484222325ULL; // FNV offset basis
+    if (caching) {
+        const char* opts = options != null ? options : "";
+        key = ocl_fnv1a64(key, d->name, strlen(d->name) + 1);
+        key = ocl_fnv1a64(key, d->driver, strlen(d->driver) + 1);
+        key = ocl_fnv1a64(key, opts, strlen(opts) + 1);
+        key = ocl_fnv1a64(key, code, bytes);
+        cl_program p = ocl_cache_load(c, key, options, stats);
+        if (p != null) { return (ocl_program_t)p; }
+    }
+    double time = seconds();
     cl_int r = 0;
     cl_program p = clCreateProgramWithSource(c->c, 1, &code, &bytes, &r);
     not_null(p, r);
     // Build the program
-    cl_device_id device_id = (cl_device_id)ocl.devices[c->ix].id;
+    cl_device_id device_id = (cl_device_id)d->id;
     r = clBuildProgram(p, 1, &device_id, options, /*notify:*/ null, // sync
         /* user_data: */null);
     if (r != 0) {
-        static char log[16 * 1024];
+        static thread_local char log[16 * 1024];
         log[0] = 0;
         // clGetProgramBuildInfo() returns invalid param if compiler crash
         (void)clGetProgramBuildInfo(p, device_id, CL_PROGRAM_BUILD_LOG,
@@ -138,9 +376,76 @@ static ocl_program_t ocl_compile_program(ocl_context_t* c,
         traceln("%s", log);
     }
     fatal_if(r != 0, "clBuildProgram() failed %s", ocl.error(r));
+    time = seconds() - time;
+    stats->misses++;
+    stats->build += time;
+    if (caching) { ocl_cache_store(p, key, time); }
     return (ocl_program_t)p;
 }
 
+static void ocl_cache_merge(const ocl_cache_t* stats) {
+    mutex_lock(&ocl_mutex);
+    ocl.cache.hits   += stats->hits;
+    ocl.cache.misses += stats->misses;
+    ocl.cache.stale  += stats->stale;
+    ocl.cache.build  += stats->build;
+    ocl.cache.load   += stats->load;
+    ocl.cache.saved  += stats->saved;
+    mutex_unlock(&ocl_mutex);
+}
+
+static ocl_program_t ocl_compile_program(ocl_context_t* c,
+        const char* code, size_t bytes, const char* options) {
+    ocl_cache_t stats = {0};
+    ocl_program_t p = ocl_build_program(c, code, bytes, options, &stats);
+    ocl_cache_merge(&stats);
+    return p;
+}
+
+// Asynchronous build runs ocl_build_program() on a host thread because
+// clBuildProgram() with notify callback is allowed to (and with some
+// drivers does) block anyway.
+
+struct ocl_build_s {
+    thread_t thread;
+    ocl_context_t* c;
+    const char* code; // must stay valid until .program() returns
+    size_t bytes;
+    char* options;    // copy
+    ocl_program_t p;
+    ocl_cache_t stats;
+};
+
+static void ocl_build_thread(void* p) {
+    struct ocl_build_s* b = (struct ocl_build_s*)p;
+    b->p = ocl_build_program(b->c, b->code, b->bytes, b->options, &b->stats);
+}
+
+static ocl_build_t ocl_compile_program_async(ocl_context_t* c,
+        const char* code, size_t bytes, const char* options) {
+    struct ocl_build_s* b = (struct ocl_build_s*)calloc(1, sizeof(*b));
+    fatal_if(b == null);
+    b->c = c;
+    b->code = code;
+    b->bytes = bytes;
+    if (options != null) {
+        b->options = strdup(options);
+        fatal_if(b->options == null);
+    }
+    b->thread = thread_start(ocl_build_thread, b);
+    return (ocl_build_t)b;
+}
+
+static ocl_program_t ocl_program(ocl_build_t build) {
+    struct ocl_build_s* b = (struct ocl_build_s*)build;
+    thread_join(b->thread);
+    ocl_cache_merge(&b->stats);
+    ocl_program_t p = b->p;
+    free(b->options);
+    free(b);
+    return p;
+}
+
 static void ocl_release_program(ocl_program_t p) {
     call(clReleaseProgram((cl_program)p));
 }
@@ -152,26 +457,300 @@ static ocl_kernel_t ocl_create_kernel(ocl_program_t p, const char* name) {
     return (ocl_kernel_t)k;
 }
 
-static ocl_event_t ocl_enqueue_range_kernel(ocl_context_t* c,
-        ocl_kernel_t k, size_t groups, size_t items_per_group,
+static void ocl_set_arg(cl_kernel k, int i, ocl_arg_t arg) {
+    if (arg.bytes == ocl_arg_svm) {
+        call(clSetKernelArgSVMPointer(k, i, arg.p));
+    } else {
+        call(clSetKernelArg(k, i, arg.bytes, arg.p));
+    }
+}
+
+static ocl_kernel_t ocl_clone_kernel(ocl_kernel_t k) {
+    // private kernel instance of the same program and function
+    // (like clCloneKernel() of OpenCL 2.1 but without argument values)
+    char name[256];
+    cl_program p = null;
+    call(clGetKernelInfo((cl_kernel)k, CL_KERNEL_FUNCTION_NAME,
+        sizeof(name), name, null));
+    call(clGetKernelInfo((cl_kernel)k, CL_KERNEL_PROGRAM,
+        sizeof(p), &p, null));
+    return ocl_create_kernel((ocl_program_t)p, name);
+}
+
+// cl_khr_command_buffer is provisional and not declared in CL/cl.h
+
+typedef struct _cl_command_buffer_khr* cl_command_buffer_khr;
+typedef cl_uint cl_sync_point_khr;
+typedef cl_properties cl_command_buffer_properties_khr;
+
+#define CL_COMMAND_BUFFER_FLAGS_KHR            0x1293
+#define CL_COMMAND_BUFFER_SIMULTANEOUS_USE_KHR (1 << 0)
+
+typedef struct ocl_command_buffer_if {
+    cl_command_buffer_khr (CL_API_CALL *create)(cl_uint num_queues,
+        const cl_command_queue* queues,
+        const cl_command_buffer_properties_khr* properties, cl_int* r);
+    cl_int (CL_API_CALL *nd_range_kernel)(cl_command_buffer_khr cb,
+        cl_command_queue q, const void* properties, cl_kernel k,
+        cl_uint dims, const size_t* offset, const size_t* global,
+        const size_t* local, cl_uint count, const cl_sync_point_khr* wait,
+        cl_sync_point_khr* sync_point, void** mutable_handle);
+    cl_int (CL_API_CALL *finalize)(cl_command_buffer_khr cb);
+    cl_int (CL_API_CALL *enqueue)(cl_uint num_queues, cl_command_queue* queues,
+        cl_command_buffer_khr cb, cl_uint count, const cl_event* wait,
+        cl_event* event);
+    cl_int (CL_API_CALL *release)(cl_command_buffer_khr cb);
+    bool bound;
+} ocl_command_buffer_if;
+
+static ocl_command_buffer_if ocl_command_buffers[countof(ocl_devices)];
+
+static ocl_command_buffer_if* ocl_command_buffer(int32_t ix) {
+    ocl_command_buffer_if* cb = &ocl_command_buffers[ix];
+    const ocl_device_t* d = &ocl.devices[ix];
+    mutex_lock(&ocl_mutex);
+    if (!cb->bound && strstr(d->extensions, "cl_khr_command_buffer") != null) {
+        cl_platform_id p = (cl_platform_id)d->platform;
+        #pragma push_macro("get_fn")
+        #define get_fn(f, name) do {                                   \
+            *(void**)&cb->f =                                           \
+                clGetExtensionFunctionAddressForPlatform(p, name);      \
+        } while (0)
+        get_fn(create,          "clCreateCommandBufferKHR");
+        get_fn(nd_range_kernel, "clCommandNDRangeKernelKHR");
+        get_fn(finalize,        "clFinalizeCommandBufferKHR");
+        get_fn(enqueue,         "clEnqueueCommandBufferKHR");
+        get_fn(release,         "clReleaseCommandBufferKHR");
+        #pragma pop_macro("get_fn")
+        cb->bound = cb->create != null && cb->nd_range_kernel != null &&
+            cb->finalize != null && cb->enqueue != null && cb->release != null;
+    }
+    mutex_unlock(&ocl_mutex);
+    return cb->bound ? cb : null;
+}
+
+static void ocl_record(ocl_context_t* c, ocl_graph_t* g) {
+    fatal_if(c->graph != null, "already recording");
+    memset(g, 0, sizeof(*g));
+    g->c = c;
+    ocl_command_buffer_if* cb = ocl_command_buffer(c->ix);
+    if (cb != null) {
+        cl_command_queue q = (cl_command_queue)c->q;
+        cl_command_buffer_properties_khr properties[] = {
+            CL_COMMAND_BUFFER_FLAGS_KHR, CL_COMMAND_BUFFER_SIMULTANEOUS_USE_KHR,
+            0
+        };
+        cl_int r = 0;
+        // drivers that cannot replay while previous replay is pending
+        // (or do not support profiling queue) fall back to launch list
+        g->cb = cb->create(1, &q, properties, &r);
+    }
+    c->graph = g;
+}
+
+static void ocl_graph_add(ocl_graph_t* g, cl_kernel k, cl_uint dims,
+        const size_t* offset, const size_t* global, const size_t* local,
         int argc, ocl_arg_t argv[]) {
+    if (g->cb != null) { // arguments already set on "k" are captured
+        ocl_command_buffer_if* cb = ocl_command_buffer(g->c->ix);
+        cl_sync_point_khr sync = 0;
+        call(cb->nd_range_kernel((cl_command_buffer_khr)g->cb, null, null, k,
+            dims, offset, global, local, g->count > 0 ? 1 : 0,
+            g->count > 0 ? &g->sync : null, &sync, null));
+        g->sync = sync;
+    } else {
+        if (g->count == g->capacity) {
+            g->capacity = g->capacity == 0 ? 16 : g->capacity * 2;
+            g->commands = (ocl_graph_command_t*)realloc(g->commands,
+                g->capacity * sizeof(ocl_graph_command_t));
+            fatal_if(g->commands == null, "out of memory");
+        }
+        ocl_graph_command_t* gc = &g->commands[g->count];
+        memset(gc, 0, sizeof(*gc));
+        cl_kernel clone = (cl_kernel)ocl_clone_kernel((ocl_kernel_t)k);
+        for (int i = 0; i < argc; i++) { ocl_set_arg(clone, i, argv[i]); }
+        gc->k = (ocl_kernel_t)clone;
+        gc->dims = dims;
+        for (cl_uint i = 0; i < dims; i++) {
+            gc->offset[i] = offset == null ? 0 : offset[i];
+            gc->global[i] = global[i];
+            gc->local[i]  = local[i];
+        }
+    }
+    g->count++;
+}
+
+static void ocl_end_record(ocl_graph_t* g) {
+    fatal_if(g->c->graph != g, "not recording");
+    g->c->graph = null;
+    if (g->cb != null) {
+        ocl_command_buffer_if* cb = ocl_command_buffer(g->c->ix);
+        call(cb->finalize((cl_command_buffer_khr)g->cb));
+    }
+}
+
+static ocl_event_t ocl_replay(ocl_graph_t* g) {
+    fatal_if(g->c->graph != null, "recording");
+    fatal_if(g->count == 0, "empty graph");
+    cl_command_queue q = (cl_command_queue)g->c->q;
+    cl_event completion = null;
+    if (g->cb != null) {
+        call(ocl_command_buffer(g->c->ix)->enqueue(1, &q,
+            (cl_command_buffer_khr)g->cb, 0, null, &completion));
+    } else {
+        for (int32_t i = 0; i < g->count; i++) {
+            const ocl_graph_command_t* gc = &g->commands[i];
+            call(clEnqueueNDRangeKernel(q, (cl_kernel)gc->k, gc->dims,
+                gc->offset, gc->global, gc->local, 0, null,
+                i == g->count - 1 ? &completion : null));
+        }
+    }
+    return (ocl_event_t)completion;
+}
+
+static void ocl_discard(ocl_graph_t* g) {
+    if (g->c != null && g->c->graph == g) { g->c->graph = null; }
+    if (g->cb != null) {
+        ocl_command_buffer_if* cb = ocl_command_buffer(g->c->ix);
+        call(cb->release((cl_command_buffer_khr)g->cb));
+    }
+    for (int32_t i = 0; g->cb == null && i < g->count; i++) {
+        ocl.release_kernel(g->commands[i].k);
+    }
+    free(g->commands);
+    for (int32_t i = 0; i < g->owned_count; i++) {
+        ocl_deallocate(g->owned[i]);
+    }
+    free(g->owned);
+    memset(g, 0, sizeof(*g));
+}
+
+static void ocl_own(ocl_graph_t* g, ocl_memory_t m) {
+    if (g->owned_count == g->owned_capacity) {
+        g->owned_capacity = g->owned_capacity == 0 ?
+            16 : g->owned_capacity * 2;
+        g->owned = (ocl_memory_t*)realloc(g->owned,
+            g->owned_capacity * sizeof(ocl_memory_t));
+        fatal_if(g->owned == null, "out of memory");
+    }
+    g->owned[g->owned_count++] = m;
+}
+
+static ocl_event_t ocl_enqueue_range_kernel_after(ocl_context_t* c,
+        ocl_kernel_t k, size_t groups, size_t items_per_group,
+        int argc, ocl_arg_t argv[], int count, ocl_event_t after[]) {
     for (int i = 0; i < argc; i++) {
-        call(clSetKernelArg((cl_kernel)k, i, argv[i].bytes, argv[i].p));
+        ocl_set_arg((cl_kernel)k, i, argv[i]);
     }
     cl_event completion = null;
     size_t total = groups * items_per_group;
     ocl_device_t* d = &ocl.devices[c->ix]; (void)d;
     assert((int64_t)groups <= d->max_groups);
     assert((int64_t)items_per_group <= d->max_items[0]);
+    assert(count == 0 || after != null);
+    if (c->graph != null) { // recorded commands are executed in order
+        ocl_graph_add(c->graph, (cl_kernel)k, 1, null, &total,
+            &items_per_group, argc, argv);
+        return null;
+    }
+    const bool profiled = ocl_is_profiled(c);
+    double user = profiled ? seconds() : 0;
     call(clEnqueueNDRangeKernel((cl_command_queue)c->q, (cl_kernel)k,
-            1, null, &total, &items_per_group, 0, null, &completion));
+            1, null, &total, &items_per_group,
+            count, count == 0 ? null : (cl_event*)after, &completion));
+    if (profiled) {
+        ocl_profiler_push(c, (cl_kernel)k, completion, seconds() - user);
+    }
+    return (ocl_event_t)completion;
+}
+
+static ocl_event_t ocl_enqueue_range_kernel(ocl_context_t* c,
+        ocl_kernel_t k, size_t groups, size_t items_per_group,
+        int argc, ocl_arg_t argv[]) {
+    return ocl_enqueue_range_kernel_after(c, k, groups, items_per_group,
+        argc, argv, 0, null);
+}
+
+static ocl_launch_t ocl_prepare(ocl_context_t* c, ocl_kernel_t k,
+        size_t groups, size_t items, int argc, ocl_arg_t argv[]) {
+    ocl_device_t* d = &ocl.devices[c->ix]; (void)d;
+    assert((int64_t)groups <= d->max_groups);
+    assert((int64_t)items <= d->max_items[0]);
+    ocl_launch_t l = {
+        .c = c, .k = ocl_clone_kernel(k),
+        .groups = groups, .items = items, .argc = argc
+    };
+    for (int i = 0; i < argc; i++) {
+        ocl_set_arg((cl_kernel)l.k, i, argv[i]);
+    }
+    return l;
+}
+
+static void ocl_bind(ocl_launch_t* l, int i, ocl_arg_t arg) {
+    fatal_if(i < 0 || i >= l->argc, "i: %d argc: %d", i, l->argc);
+    ocl_set_arg((cl_kernel)l->k, i, arg);
+}
+
+static ocl_event_t ocl_launch(ocl_launch_t* l) {
+    fatal_if(l->c->graph != null, "prepared launches are not recorded");
+    cl_event completion = null;
+    size_t total = l->groups * l->items;
+    const bool profiled = ocl_is_profiled(l->c);
+    double user = profiled ? seconds() : 0;
+    call(clEnqueueNDRangeKernel((cl_command_queue)l->c->q, (cl_kernel)l->k,
+            1, null, &total, &l->items, 0, null, &completion));
+    if (profiled) {
+        ocl_profiler_push(l->c, (cl_kernel)l->k, completion, seconds() - user);
+    }
     return (ocl_event_t)completion;
 }
 
+static void ocl_fire(ocl_launch_t* l) {
+    fatal_if(l->c->graph != null, "prepared launches are not recorded");
+    size_t total = l->groups * l->items;
+    cl_event completion = null; // only created for the profiler
+    const bool profiled = ocl_is_profiled(l->c);
+    double user = profiled ? seconds() : 0;
+    call(clEnqueueNDRangeKernel((cl_command_queue)l->c->q, (cl_kernel)l->k,
+            1, null, &total, &l->items, 0, null,
+            profiled ? &completion : null));
+    if (profiled) {
+        ocl_profiler_push(l->c, (cl_kernel)l->k, completion, seconds() - user);
+        call(clReleaseEvent(completion));
+    }
+}
+
+static void ocl_unprepare(ocl_launch_t* l) {
+    ocl.release_kernel(l->k);
+    memset(l, 0, sizeof(*l));
+}
+
+static void ocl_profile_fold(ocl_override_t* ov) {
+    // profiling[] is full: folds all entries into profiling[0]
+    ocl_profiling_t* p = ov->profiling;
+    for (int64_t i = 0; i < ov->profiling_count; i++) {
+        if (p[i].e != null) { ocl.wait(&p[i].e, 1); ocl.profile(&p[i]); }
+    }
+    for (int64_t i = 1; i < ov->profiling_count; i++) {
+        p[0].start   = min(p[0].start, p[i].start);
+        p[0].end     = max(p[0].end,   p[i].end);
+        p[0].time   += p[i].time;
+        p[0].user   += p[i].user;
+        p[0].gflops += p[i].gflops;
+        p[0].i32ops += p[i].i32ops;
+        p[0].i64ops += p[i].i64ops;
+        p[0].merged += p[i].merged + 1;
+    }
+    ov->profiling_count = 1;
+}
+
 static ocl_profiling_t* ocl_profile_add(ocl_context_t* c, ocl_event_t e) {
     fatal_if(!ocl.is_profiling(c));
-    fatal_if(c->ov->profiling_count == c->ov->max_profiling_count,
-            "profiling[%lld] is too small", c->ov->max_profiling_count);
+    if (c->ov->profiling_count == c->ov->max_profiling_count) {
+        fatal_if(c->ov->max_profiling_count < 2,
+                "profiling[%lld] is too small", c->ov->max_profiling_count);
+        ocl_profile_fold(c->ov);
+    }
     ocl_profiling_t* p = &c->ov->profiling[c->ov->profiling_count++];
     memset(p, 0, sizeof(*p));
     ocl.retain_event(e); // increment reference count
@@ -180,6 +759,7 @@ static ocl_profiling_t* ocl_profile_add(ocl_context_t* c, ocl_event_t e) {
 }
 
 static void ocl_profile(ocl_profiling_t* p) {
+    if (p->e == null) { return; } // already folded (see ocl_profile_fold)
     #pragma push_macro("get_info")
     #define get_info(n, v) do {                                                \
         call(clGetEventProfilingInfo((cl_event)p->e, n, sizeof(v), &v, null)); \
@@ -203,27 +783,265 @@ static void ocl_profile(ocl_profiling_t* p) {
     }
     ocl.release_event(p->e); // decrement refernce count
     p->e = null;
-
-//  uint64_t ema_samples = p->ema_samples == 0 ? 128 : p->ema_samples;
-//  // exponential moving average of 128 samples
-//  const double ema_alpha = 1.0 / (double)ema_samples;
-//  p->time = (p->end - p->start) / (double)NSEC_IN_SEC;
-//  if (items != 0) {
-//      double seconds_per_item = p->time / items;
-//      double ops_per_second = 1.0 / seconds_per_item;
-//      p->gops = ops_per_second / (1000 * 1000 * 1000);
-//      p->ema.gops = p->ema.gops * (1.0 - ema_alpha) + p->gops * ema_alpha;
-//  } else {
-//      p->gops = 0; // cannot determine for unknown number of items
-//  }
-//  p->ema.time = p->ema.time * (1.0 - ema_alpha) + p->time * ema_alpha;
     // client is responsible updating and calculating .user fields
 }
 
+static_assertion(sizeof(((ocl_profiler_t*)0)->lock) == sizeof(mutex_t));
+static_assertion(sizeof(((ocl_profiler_t*)0)->pushed) == sizeof(cond_t));
+
+static ocl_profiler_t* ocl_profilers; // running profilers, under ocl_mutex
+
+static mutex_t* ocl_profiler_lock(ocl_profiler_t* pr) {
+    return (mutex_t*)&pr->lock;
+}
+
+static cond_t* ocl_profiler_pushed(ocl_profiler_t* pr) {
+    return (cond_t*)&pr->pushed;
+}
+
+static cond_t* ocl_profiler_resolved(ocl_profiler_t* pr) {
+    return (cond_t*)&pr->resolved;
+}
+
+static void ocl_stats_add(ocl_stats_t* s, int64_t count, double v,
+        double alpha) {
+    if (count == 0) {
+        s->ema = v; s->min = v; s->max = v;
+    } else {
+        s->ema = s->ema * (1.0 - alpha) + v * alpha;
+        s->min = min(s->min, v);
+        s->max = max(s->max, v);
+    }
+}
+
+static void ocl_profiler_resolve(ocl_profiler_t* pr) {
+    // aggregates completed oldest event of the ring. Under the lock.
+    const int64_t i = pr->head % ocl_profiler_ring;
+    cl_event e = (cl_event)pr->ring[i].e;
+    cl_ulong start = 0;
+    cl_ulong end = 0;
+    call(clGetEventProfilingInfo(e, CL_PROFILING_COMMAND_START,
+        sizeof(start), &start, null));
+    call(clGetEventProfilingInfo(e, CL_PROFILING_COMMAND_END,
+        sizeof(end), &end, null));
+    call(clReleaseEvent(e));
+    pr->ring[i].e = null;
+    pr->head++;
+    const double alpha = pr->ema_alpha == 0 ? 1.0 / 128 : pr->ema_alpha;
+    const double time = (end - start) / (double)NSEC_IN_SEC;
+    const double user = pr->ring[i].user;
+    const int32_t k = pr->ring[i].kernel;
+    ocl_kernel_stats_t* s = &pr->kernels[k].stats;
+    ocl_stats_add(&s->time, s->count, time, alpha);
+    ocl_stats_add(&s->user, s->count, user, alpha);
+    pr->kernels[k].time[s->count % ocl_profiler_window] = time;
+    pr->kernels[k].user[s->count % ocl_profiler_window] = user;
+    s->count++;
+}
+
+static void ocl_profiler_thread(void* p) {
+    // the only consumer of the ring: entries are removed by this thread
+    // thus the head event stays valid while waited for outside the lock
+    ocl_profiler_t* pr = (ocl_profiler_t*)p;
+    mutex_t* lock = ocl_profiler_lock(pr);
+    mutex_lock(lock);
+    for (;;) {
+        while (!pr->quit && pr->head == pr->tail) {
+            cond_wait(ocl_profiler_pushed(pr), lock);
+        }
+        if (pr->head == pr->tail) { break; } // quit and drained
+        cl_event e = (cl_event)pr->ring[pr->head % ocl_profiler_ring].e;
+        mutex_unlock(lock);
+        call(clWaitForEvents(1, &e)); // implicit flush of the queue
+        mutex_lock(lock);
+        ocl_profiler_resolve(pr);
+        cond_broadcast(ocl_profiler_resolved(pr));
+    }
+    mutex_unlock(lock);
+}
+
+static void ocl_profiler_start(ocl_profiler_t* pr) {
+    fatal_if(pr->thread != null, "profiler is already in use");
+    pr->head = 0;
+    pr->tail = 0;
+    pr->count = 0;
+    memset(pr->handles, 0, sizeof(pr->handles));
+    pr->lock = null;
+    pr->pushed = null;
+    pr->resolved = null;
+    pr->quit = false;
+    mutex_lock(&ocl_mutex);
+    pr->next = ocl_profilers;
+    ocl_profilers = pr;
+    mutex_unlock(&ocl_mutex);
+    pr->thread = thread_start(ocl_profiler_thread, pr);
+}
+
+static void ocl_profiler_stop(ocl_profiler_t* pr) {
+    mutex_lock(ocl_profiler_lock(pr));
+    pr->quit = true;
+    cond_signal(ocl_profiler_pushed(pr));
+    mutex_unlock(ocl_profiler_lock(pr));
+    thread_join((thread_t)pr->thread); // thread drains the ring
+    pr->thread = null;
+    mutex_lock(&ocl_mutex);
+    ocl_profiler_t** pp = &ocl_profilers;
+    while (*pp != pr) { pp = &(*pp)->next; }
+    *pp = pr->next;
+    mutex_unlock(&ocl_mutex);
+    pr->next = null;
+}
+
+static int32_t ocl_profiler_hash(cl_kernel k) {
+    return (int32_t)(((uintptr_t)k >> 4) % ocl_profiler_handles);
+}
+
+static void ocl_profiler_forget(cl_kernel k) {
+    // released kernel handle can be reused by a different kernel
+    mutex_lock(&ocl_mutex);
+    for (ocl_profiler_t* pr = ocl_profilers; pr != null; pr = pr->next) {
+        mutex_lock(ocl_profiler_lock(pr));
+        const int32_t h = ocl_profiler_hash(k);
+        if (pr->handles[h].k == (ocl_kernel_t)k) { pr->handles[h].k = null; }
+        mutex_unlock(ocl_profiler_lock(pr));
+    }
+    mutex_unlock(&ocl_mutex);
+}
+
+static int32_t ocl_profiler_kernel(ocl_profiler_t* pr, const char* name) {
+    // index of kernel "name" in kernels[], adds new one. Under the lock.
+    for (int32_t i = 0; i < pr->count; i++) {
+        if (strcmp(pr->kernels[i].stats.name, name) == 0) { return i; }
+    }
+    const int32_t other = ocl_profiler_kernels - 1;
+    if (pr->count == ocl_profiler_kernels) { return other; }
+    const int32_t i = pr->count++;
+    memset(&pr->kernels[i].stats, 0, sizeof(pr->kernels[i].stats));
+    snprintf(pr->kernels[i].stats.name, countof(pr->kernels[i].stats.name),
+        "%s", i == other ? "other" : name);
+    return i;
+}
+
+static void ocl_profiler_push(ocl_context_t* c, cl_kernel k, cl_event e,
+        double user) {
+    ocl_profiler_t* pr = c->ov->profiler;
+    mutex_t* lock = ocl_profiler_lock(pr);
+    call(clRetainEvent(e)); // released by ocl_profiler_resolve()
+    const int32_t h = ocl_profiler_hash(k);
+    mutex_lock(lock);
+    if (pr->handles[h].k != (ocl_kernel_t)k) { // first enqueue of "k"
+        mutex_unlock(lock);
+        char name[256];
+        call(clGetKernelInfo(k, CL_KERNEL_FUNCTION_NAME, sizeof(name),
+            name, null));
+        mutex_lock(lock);
+        pr->handles[h].kernel = ocl_profiler_kernel(pr, name);
+        pr->handles[h].k = (ocl_kernel_t)k;
+    }
+    const int32_t kernel = pr->handles[h].kernel;
+    while (pr->tail - pr->head == ocl_profiler_ring) { // full
+        cond_wait(ocl_profiler_resolved(pr), lock);
+    }
+    const int64_t i = pr->tail % ocl_profiler_ring;
+    pr->ring[i].e = (ocl_event_t)e;
+    pr->ring[i].kernel = kernel;
+    pr->ring[i].user = user;
+    pr->tail++;
+    cond_signal(ocl_profiler_pushed(pr));
+    mutex_unlock(lock);
+}
+
+static void ocl_profiler_sync(ocl_profiler_t* pr) {
+    // waits for the thread to resolve events that already completed.
+    // Under the lock.
+    while (pr->head != pr->tail &&
+           ocl.is_complete(pr->ring[pr->head % ocl_profiler_ring].e)) {
+        cond_wait(ocl_profiler_resolved(pr), ocl_profiler_lock(pr));
+    }
+}
+
+static int ocl_compare_doubles(const void* p0, const void* p1) {
+    const double d0 = *(const double*)p0;
+    const double d1 = *(const double*)p1;
+    return d0 < d1 ? -1 : (d0 > d1 ? 1 : 0);
+}
+
+static void ocl_percentiles(ocl_stats_t* s, const double window[],
+        int64_t count) {
+    double sorted[ocl_profiler_window];
+    const int64_t n = min(count, (int64_t)ocl_profiler_window);
+    if (n > 0) {
+        memcpy(sorted, window, n * sizeof(sorted[0]));
+        qsort(sorted, (size_t)n, sizeof(sorted[0]), ocl_compare_doubles);
+        s->p50 = sorted[(n - 1) * 50 / 100];
+        s->p99 = sorted[(n - 1) * 99 / 100];
+    }
+}
+
+static void ocl_profiler_copy(ocl_profiler_t* pr, int32_t i,
+        ocl_kernel_stats_t* s) { // under the lock
+    *s = pr->kernels[i].stats;
+    ocl_percentiles(&s->time, pr->kernels[i].time, s->count);
+    ocl_percentiles(&s->user, pr->kernels[i].user, s->count);
+}
+
+static int32_t ocl_stats(ocl_context_t* c, ocl_kernel_stats_t s[],
+        int32_t count) {
+    ocl_profiler_t* pr = c->ov != null ? c->ov->profiler : null;
+    int32_t n = 0;
+    if (pr != null) {
+        mutex_lock(ocl_profiler_lock(pr));
+        ocl_profiler_sync(pr);
+        n = min(count, pr->count);
+        for (int32_t i = 0; i < n; i++) { ocl_profiler_copy(pr, i, &s[i]); }
+        mutex_unlock(ocl_profiler_lock(pr));
+    }
+    return n;
+}
+
+static bool ocl_stats_of(ocl_context_t* c, const char* name,
+        ocl_kernel_stats_t* s) {
+    ocl_profiler_t* pr = c->ov != null ? c->ov->profiler : null;
+    bool found = false;
+    if (pr != null) {
+        mutex_lock(ocl_profiler_lock(pr));
+        ocl_profiler_sync(pr);
+        for (int32_t i = 0; i < pr->count && !found; i++) {
+            found = strcmp(pr->kernels[i].stats.name, name) == 0;
+            if (found) { ocl_profiler_copy(pr, i, s); }
+        }
+        mutex_unlock(ocl_profiler_lock(pr));
+    }
+    return found;
+}
+
+static void ocl_stats_reset(ocl_context_t* c) {
+    ocl_profiler_t* pr = c->ov != null ? c->ov->profiler : null;
+    if (pr != null) {
+        mutex_lock(ocl_profiler_lock(pr));
+        // names are kept: in flight ring entries refer to kernels[] indices
+        for (int32_t i = 0; i < pr->count; i++) {
+            ocl_kernel_stats_t* s = &pr->kernels[i].stats;
+            memset(&s->time, 0, sizeof(s->time));
+            memset(&s->user, 0, sizeof(s->user));
+            s->count = 0;
+        }
+        mutex_unlock(ocl_profiler_lock(pr));
+    }
+}
+
 static void ocl_wait(ocl_event_t* events, int count) {
     call(clWaitForEvents(count, (cl_event*)events));
 }
 
+static bool ocl_is_complete(ocl_event_t e) {
+    cl_int status = 0;
+    call(clGetEventInfo((cl_event)e, CL_EVENT_COMMAND_EXECUTION_STATUS,
+        sizeof(status), &status, null));
+    fatal_if(status < 0, "%s", ocl.error(status)); // abnormally terminated
+    return status == CL_COMPLETE;
+}
+
 static void ocl_retain_event(ocl_event_t e) {
     call(clRetainEvent((cl_event)e));
 }
@@ -233,6 +1051,7 @@ static void ocl_release_event(ocl_event_t e) {
 }
 
 static void ocl_release_kernel(ocl_kernel_t k) {
+    ocl_profiler_forget((cl_kernel)k);
     call(clReleaseKernel((cl_kernel)k));
 }
 
@@ -253,7 +1072,108 @@ static void ocl_kernel_info(ocl_context_t* c, ocl_kernel_t kernel,
     #pragma pop_macro("get_val")
 }
 
+// Automatic local size: automatic dimensions share the work-group budget
+// evenly (powers of 2), dimension 0 (contiguous in memory for row major
+// data) gets at least preferred work-group multiple items. Divisors of
+// global size close to the target are preferred because they avoid
+// enqueueing the tail as a separate NDRange.
+
+static void ocl_local_size(ocl_context_t* c, ocl_kernel_t k, ocl_range_t* r) {
+    fatal_if(r->dims < 1 || r->dims > 3, "dims: %d", r->dims);
+    const ocl_device_t* d = &ocl.devices[c->ix];
+    ocl_kernel_info_t info = {0};
+    ocl_kernel_info(c, k, &info);
+    // d->max_groups may be overridden as groups cap (tests), kernel limit
+    // is the real constraint on items in a work-group
+    int64_t budget = info.work_group;
+    int autos = 0;
+    for (int i = 0; i < r->dims; i++) {
+        if (r->local[i] == 0) {
+            autos++;
+        } else {
+            budget /= (int64_t)r->local[i];
+        }
+    }
+    fatal_if(budget < 1, "local[] exceeds work-group limit %lld",
+             info.work_group);
+    const int64_t multiple = max(1, info.preferred_work_group_multiple);
+    for (int i = 0; i < r->dims; i++) {
+        if (r->local[i] != 0) { continue; }
+        int64_t target = 1; // largest power of 2: target^autos <= budget
+        for (;;) {
+            int64_t p = 1;
+            for (int j = 0; j < autos; j++) { p *= target * 2; }
+            if (p > budget) { break; }
+            target *= 2;
+        }
+        if (i == 0) { target = max(target, min(multiple, budget)); }
+        const int64_t global = max(1, (int64_t)r->global[i]);
+        const int64_t cap = max(1, min(min(target, d->max_items[i]), global));
+        int64_t l = cap;
+        while (l > cap / 2 && global % l != 0) { l--; }
+        if (global % l != 0) { l = cap; }
+        r->local[i] = (size_t)l;
+        budget /= l;
+        autos--;
+    }
+}
+
+static ocl_event_t ocl_enqueue_ndrange_kernel(ocl_context_t* c,
+        ocl_kernel_t k, const ocl_range_t* range, int argc, ocl_arg_t argv[],
+        int count, ocl_event_t after[]) {
+    ocl_range_t r = *range;
+    fatal_if(r.dims < 1 || r.dims > 3, "dims: %d", r.dims);
+    if (r.local[0] == 0 || (r.dims > 1 && r.local[1] == 0) ||
+       (r.dims > 2 && r.local[2] == 0)) {
+        ocl_local_size(c, k, &r);
+    }
+    const ocl_device_t* d = &ocl.devices[c->ix]; (void)d;
+    for (int i = 0; i < r.dims; i++) {
+        assert(r.local[i] > 0 && (int64_t)r.local[i] <= d->max_items[i]);
+    }
+    assert(count == 0 || after != null);
+    for (int i = 0; i < argc; i++) {
+        ocl_set_arg((cl_kernel)k, i, argv[i]);
+    }
+    size_t body[3] = {0};
+    for (int i = 0; i < r.dims; i++) {
+        body[i] = r.global[i] / r.local[i] * r.local[i];
+    }
+    cl_event completion = null;
+    // bit "i" of part selects body (0) or tail (1) of dimension "i"
+    for (int part = 0; part < (1 << r.dims); part++) {
+        size_t offset[3], global[3], local[3];
+        bool empty = false;
+        for (int i = 0; i < r.dims; i++) {
+            const bool tail = ((part >> i) & 1) != 0;
+            offset[i] = r.offset[i] + (tail ? body[i] : 0);
+            global[i] = tail ? r.global[i] - body[i] : body[i];
+            local[i]  = tail ? global[i] : r.local[i];
+            empty |= global[i] == 0;
+        }
+        if (!empty && c->graph != null) {
+            ocl_graph_add(c->graph, (cl_kernel)k, r.dims, offset, global,
+                local, argc, argv);
+        } else if (!empty) {
+            if (completion != null) { call(clReleaseEvent(completion)); }
+            const bool profiled = ocl_is_profiled(c);
+            double user = profiled ? seconds() : 0;
+            call(clEnqueueNDRangeKernel((cl_command_queue)c->q, (cl_kernel)k,
+                r.dims, offset, global, local,
+                count, count == 0 ? null : (cl_event*)after, &completion));
+            if (profiled) { // each part is a separate sample
+                ocl_profiler_push(c, (cl_kernel)k, completion, seconds() - user);
+            }
+        }
+    }
+    fatal_if(completion == null && c->graph == null, "empty range");
+    return (ocl_event_t)completion;
+}
+
 static void ocl_close(ocl_context_t* c) {
+    if (c->ov != null && c->ov->profiler != null) {
+        ocl_profiler_stop(c->ov->profiler);
+    }
     ocl_dispose_queue(c);
     call(clReleaseContext((cl_context)c->c));
     if (c->ov != null) {
@@ -265,7 +1185,7 @@ static void ocl_close(ocl_context_t* c) {
 }
 
 static const char* ocl_error(int r) {
-    static char error[128];
+    static thread_local char error[128];
     #define case_(x) case x: snprintf(error, countof(error), "%d " #x, r); break
     switch (r) {
         case_(CL_DEVICE_NOT_FOUND);
@@ -363,6 +1283,7 @@ static void ocl_init(void) {
                 d->platform = platforms[i];
                 get_str(CL_DEVICE_NAME, d->name);
                 get_str(CL_DEVICE_VENDOR, d->vendor);
+                get_str(CL_DRIVER_VERSION, d->driver);
                 char text[4096];
                 get_str(CL_DEVICE_VERSION, text); // e.g. "OpenCL 3.0 CUDA"
                 int minor = 0; // sscanf wants type "int" not "int32_t"
@@ -385,6 +1306,20 @@ static void ocl_init(void) {
                 get_val(CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS, d->dimensions);
                 call(d->dimensions > countof(d->max_items));
                 get_val(CL_DEVICE_MAX_WORK_ITEM_SIZES, d->max_items);
+                cl_bool unified = false; // deprecated in 2.0 but reported
+                get_val(CL_DEVICE_HOST_UNIFIED_MEMORY, unified);
+                cl_uint align = 0; // in bits
+                get_val(CL_DEVICE_MEM_BASE_ADDR_ALIGN, align);
+                d->base_align = max(1, align / 8);
+                d->svm = 0;
+                if (d->version_major >= 2) {
+                    cl_device_svm_capabilities svm = 0;
+                    get_val(CL_DEVICE_SVM_CAPABILITIES, svm);
+                    d->svm = (int64_t)svm;
+                }
+                cl_device_type type = 0;
+                get_val(CL_DEVICE_TYPE, type);
+                d->unified_memory = unified || (type & CL_DEVICE_TYPE_CPU) != 0;
                 d->fp_config = 0;
                 d->fp_config |= ext("cl_khr_fp64") ? ocl_fp64 : 0;
                 d->fp_config |= ext("cl_khr_fp16") ? ocl_fp16 : 0;
@@ -406,6 +1341,43 @@ static void ocl_init(void) {
     #pragma pop_macro("ext")
     #pragma pop_macro("get_val")
     #pragma pop_macro("get_str")
+    if (ocl.cache.folder == null) {
+        const char* temp = getenv("TEMP");
+        ocl.cache.folder = temp != null ? temp : "";
+    }
+}
+
+static int32_t ocl_sub_devices(int32_t ix, int32_t parts) {
+    call(!(0 <= ix && ix < ocl.count));
+    ocl_device_t* d = &ocl.devices[ix];
+    cl_device_id id = (cl_device_id)d->id;
+    cl_uint max_sub_devices = 0;
+    call(clGetDeviceInfo(id, CL_DEVICE_PARTITION_MAX_SUB_DEVICES,
+        sizeof(max_sub_devices), &max_sub_devices, null));
+    if (parts < 2 || (cl_uint)parts > max_sub_devices ||
+        d->compute_units < parts ||
+        ocl.count + parts > countof(ocl_devices)) {
+        return 0;
+    }
+    const cl_device_partition_property properties[] = {
+        CL_DEVICE_PARTITION_EQUALLY,
+        (cl_device_partition_property)(d->compute_units / parts), 0
+    };
+    cl_device_id ids[countof(ocl_devices)] = {0};
+    cl_uint n = 0;
+    if (clCreateSubDevices(id, properties, parts, ids, &n) != 0) { return 0; }
+    // sub-devices live until process exit (never released)
+    for (cl_uint i = 0; i < n && i < (cl_uint)parts; i++) {
+        ocl_device_t* s = &ocl.devices[ocl.count];
+        *s = *d;
+        s->id = (ocl_device_id_t)ids[i];
+        cl_uint units = 0;
+        call(clGetDeviceInfo(ids[i], CL_DEVICE_MAX_COMPUTE_UNITS,
+            sizeof(units), &units, null));
+        s->compute_units = units;
+        ocl.count++;
+    }
+    return (int32_t)min(n, (cl_uint)parts);
 }
 
 // Intel(R) UHD Graphics does not support ocl_fp64
@@ -431,7 +1403,7 @@ static void ocl_init(void) {
 // https://github.com/KhronosGroup/OpenCL-Docs/pull/355
 
 static const char* ocl_fp_config_to_string(int64_t config) {
-    static char s[1024];
+    static thread_local char s[1024];
     s[0] = 0;
     #pragma push_macro("append")
     #define append(text) do { strcat(s, ", " text); } while (0)
@@ -455,6 +1427,9 @@ static void ocl_dump(int ix) {
         d->version_major, d->version_minor, d->c_version_major, d->c_version_minor);
     traceln("compute_units:    %lld @ %lldMHz", d->compute_units, d->clock_frequency);
     traceln("global_memory:    %lldMB", d->global_memory / MB);
+    traceln("unified_memory:   %s", d->unified_memory ? "true" : "false");
+    traceln("base_align:       %lld", d->base_align);
+    traceln("svm:              0x%llX", d->svm);
     traceln("local_memory:     %lldMB", d->local_memory / MB);
     traceln("max_groups:       %lld", d->max_groups);
     traceln("dimensions:       %lld", d->dimensions);
@@ -467,21 +1442,51 @@ static void ocl_dump(int ix) {
 
 ocl_if ocl = {
     .init = ocl_init,
+    .sub_devices = ocl_sub_devices,
     .dump = ocl_dump,
     .open = ocl_open,
+    .fork = ocl_fork,
     .is_profiling = ocl_is_profiling,
     .error = ocl_error,
     .allocate = ocl_allocate,
+    .wrap = ocl_wrap,
+    .sub_buffer = ocl_sub_buffer,
+    .svm_alloc = ocl_svm_alloc,
+    .svm_free = ocl_svm_free,
     .deallocate = ocl_deallocate,
     .map = ocl_map,
     .unmap = ocl_unmap,
+    .map_async = ocl_map_async,
+    .unmap_async = ocl_unmap_async,
+    .read = ocl_read,
+    .write = ocl_write,
     .compile_program = ocl_compile_program,
+    .compile_program_async = ocl_compile_program_async,
+    .program = ocl_program,
     .create_kernel = ocl_create_kernel,
     .kernel_info = ocl_kernel_info,
     .enqueue_range_kernel = ocl_enqueue_range_kernel,
+    .enqueue_range_kernel_after = ocl_enqueue_range_kernel_after,
+    .local_size = ocl_local_size,
+    .enqueue_ndrange_kernel = ocl_enqueue_ndrange_kernel,
+    .prepare = ocl_prepare,
+    .bind = ocl_bind,
+    .launch = ocl_launch,
+    .fire = ocl_fire,
+    .unprepare = ocl_unprepare,
+    .clone_kernel = ocl_clone_kernel,
+    .record = ocl_record,
+    .end_record = ocl_end_record,
+    .replay = ocl_replay,
+    .discard = ocl_discard,
+    .own = ocl_own,
     .wait = ocl_wait,
+    .is_complete = ocl_is_complete,
     .profile_add = ocl_profile_add,
     .profile = ocl_profile,
+    .stats = ocl_stats,
+    .stats_of = ocl_stats_of,
+    .stats_reset = ocl_stats_reset,
     .retain_event = ocl_retain_event,
     .release_event = ocl_release_event,
     .release_kernel = ocl_release_kernel,
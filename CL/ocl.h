@@ -11,6 +11,7 @@ typedef struct ocl_memory_s*    ocl_memory_t;
 typedef struct ocl_program_s*   ocl_program_t;
 typedef struct ocl_kernel_s*    ocl_kernel_t;
 typedef struct ocl_event_s*     ocl_event_t;
+typedef struct ocl_build_s*     ocl_build_t; // pending program build
 
 enum { // flavor (bitset because of collaboration and mixed solutions)
     ocl_nvidia    = (1 << 0),
@@ -41,6 +42,13 @@ enum { // fp_config
     ocl_fp64                             = (1 << 30)
 };
 
+enum { // svm capabilities bits (matching OpenCL)
+    ocl_svm_coarse_grain_buffer = (1 << 0),
+    ocl_svm_fine_grain_buffer   = (1 << 1),
+    ocl_svm_fine_grain_system   = (1 << 2),
+    ocl_svm_atomics             = (1 << 3)
+};
+
 // __kernel can use
 // #pragma OPENCL SELECT_ROUNDING_MODE rte // rte rtz rtp rtn
 // and
@@ -52,6 +60,7 @@ typedef struct ocl_device_s {
     ocl_device_id_t id; // device id
     char  name[128];
     char  vendor[128];
+    char  driver[128]; // CL_DRIVER_VERSION
     int32_t version_major;    // OpenCL version
     int32_t version_minor;
     int32_t c_version_major;  // OpenCL kernel .cl C language version
@@ -60,13 +69,16 @@ typedef struct ocl_device_s {
     int64_t global_memory;    // size in bytes
     int64_t local_memory;     // size in bytes
     int64_t compute_units;    // max compute units, see: *** below
-    int64_t max_groups;       // max number of work groups, see: ** below
+    int64_t max_groups;       // CL_DEVICE_MAX_WORK_GROUP_SIZE, see: ** below
     int64_t dimensions;       // dimensionality of work items
     int64_t max_items[3];     // max work items in a group per dimension
     int32_t flavor;           // GPU manufacturer - tricky, could be a mix
     int32_t fp_config;
     int64_t double_fp_config;
     int64_t float_fp_config;
+    bool    unified_memory;   // host and device share memory (iGPU or CPU)
+    int64_t base_align;       // bytes, sub-buffer origin alignment
+    int64_t svm;              // ocl_svm_* bits, 0 for OpenCL < 2.0
     char    extensions[4096]; // use strstr(extensions, "cl_khr_fp16")
 } ocl_device_t;
 
@@ -91,6 +103,9 @@ typedef struct ocl_kernel_info_s { // CL_KERNEL_*
 // https://stackoverflow.com/questions/62236072/understanding-cl-device-max-work-group-size-limit-opencl
 // https://registry.khronos.org/OpenCL/sdk/2.2/docs/man/html/clEnqueueNDRangeKernel.html
 // usage of "size" "max" is confusing in OpenCL docs this avoided here
+// max_groups is filled from CL_DEVICE_MAX_WORK_GROUP_SIZE which is a limit
+// of work items in a single group. OpenCL does not limit number of groups.
+// It is used (and overriden in tests) as a cap on groups in a launch.
 
 typedef struct ocl_profiling_s {
     ocl_event_t e;
@@ -108,14 +123,74 @@ typedef struct ocl_profiling_s {
     double  g32ops; // Giga int32 ops
     double  g64ops; // Giga int64 ops
     double  user; // seconds: host time (to be filled by client)
-//  uint64_t ema_samples; // 0 defaults to 128 samples
-//  struct { // exponential moving average
-//      double  user; // seconds: host time (to be calculated by client)
-//      double  time; // seconds: end - start
-//      double  gops; // Giga items per second
-//  } ema;
+    uint64_t merged; // number of earlier entries folded into profiling[0]
 } ocl_profiling_t;
 
+// When profiling[] is full .profile_add() waits for all entries, folds
+// them into profiling[0] (times, user and ops are summed, .merged counts
+// folded entries) and continues from profiling[1].
+
+// Profiler: every kernel enqueue of the context (except .replay())
+// places its completion event into the ring and signals background
+// thread which blocks in clWaitForEvents() on the oldest event and
+// aggregates kernel time and user time (host time spent in enqueue call)
+// per kernel function name. Idle thread sleeps on condition variable.
+// Enqueue into a full ring waits for the thread to resolve oldest event.
+// Function name is queried once per kernel handle (cached until
+// .release_kernel()), names beyond ocl_profiler_kernels - 1 are
+// aggregated as "other". Percentiles are computed over the last
+// ocl_profiler_window samples.
+
+enum {
+    ocl_profiler_ring    = 1024, // in flight events
+    ocl_profiler_kernels = 64,   // distinct kernel names including "other"
+    ocl_profiler_window  = 1024, // samples kept for percentiles
+    ocl_profiler_handles = 256   // kernel handle to name cache
+};
+
+typedef struct ocl_stats_s { // seconds
+    double ema; // exponential moving average
+    double min;
+    double max;
+    double p50; // median
+    double p99;
+} ocl_stats_t;
+
+typedef struct ocl_kernel_stats_s {
+    char name[64];
+    int64_t count; // number of resolved invocations
+    ocl_stats_t time; // device: end - start
+    ocl_stats_t user; // host: enqueue call
+} ocl_kernel_stats_t;
+
+typedef struct ocl_profiler_s {
+    double ema_alpha; // 0 defaults to 1/128
+    // private:
+    struct {
+        ocl_event_t e;
+        int32_t kernel; // index in kernels[]
+        double user;
+    } ring[ocl_profiler_ring];
+    int64_t head; // next to resolve
+    int64_t tail; // next to push
+    struct {
+        ocl_kernel_stats_t stats;
+        double time[ocl_profiler_window];
+        double user[ocl_profiler_window];
+    } kernels[ocl_profiler_kernels];
+    int32_t count; // number of kernels[]
+    struct {
+        ocl_kernel_t k;
+        int32_t kernel; // index in kernels[]
+    } handles[ocl_profiler_handles]; // direct mapped by kernel handle
+    void* lock;     // mutex_t (see rt.h) guards all of the above
+    void* pushed;   // cond_t: ring is not empty or quit
+    void* resolved; // cond_t: head of the ring resolved
+    void* thread;   // background resolver
+    bool quit;
+    struct ocl_profiler_s* next; // list of running profilers
+} ocl_profiler_t;
+
 typedef struct ocl_override_s {
     ocl_profiling_t* profiling;  // null - no profiling
     int64_t max_profiling_count; // number of elemnts in profiling[] array
@@ -126,6 +201,7 @@ typedef struct ocl_override_s {
     int64_t max_items;  // == 0 use GPU reported value
     int64_t max_groups_restore; // if max_groups was overriden it will be restored
     int64_t max_items_restore;  // if max_items  was overriden it will be restored
+    ocl_profiler_t* profiler;   // null - no profiler (see ocl_profiler_t)
 } ocl_override_t;
 
 typedef struct ocl_context_s {
@@ -133,6 +209,7 @@ typedef struct ocl_context_s {
     void*   c; // OpenCL context
     void*   q; // OpenCL command queue
     ocl_override_t* ov;
+    struct ocl_graph_s* graph; // non null while recording (see .record())
 } ocl_context_t;
 
 typedef struct ocl_arg_s {
@@ -140,6 +217,73 @@ typedef struct ocl_arg_s {
     size_t bytes;
 } ocl_arg_t;
 
+// {null, bytes} argument is __local memory of "bytes"
+// {pointer, ocl_arg_svm} argument is SVM pointer (see .svm_alloc())
+
+#define ocl_arg_svm ((size_t)-1)
+
+// Prepared launch: kernel instance, NDRange and arguments are bound once
+// by .prepare() and re-enqueued by .launch() or .fire() after rebinding
+// only the arguments that changed with .bind(). Each prepared launch owns
+// a private kernel instance, thus other launches of the same kernel
+// do not disturb its arguments.
+
+typedef struct ocl_launch_s {
+    ocl_context_t* c;
+    ocl_kernel_t k; // private kernel instance (released by .unprepare())
+    size_t groups;
+    size_t items;
+    int argc;
+} ocl_launch_t;
+
+// N-dimensional range for .enqueue_ndrange_kernel(): global[i] does not
+// have to be a multiple of local[i]. Divisible "body" and remainder "tail"
+// of each dimension are enqueued as separate NDRanges (up to 2^dims) with
+// proper global offsets, thus the last group in a dimension can be
+// smaller (like OpenCL 2.0 non-uniform work-groups). Kernels should use
+// get_global_id() (includes offset) and get_local_size(), and must not
+// assume get_group_id() * get_local_size() == get_global_id() - offset.
+
+typedef struct ocl_range_s {
+    int32_t dims;      // 1, 2 or 3
+    size_t  offset[3]; // global offset, get_global_offset(i)
+    size_t  global[3]; // work-items in each dimension
+    size_t  local[3];  // work-items per group, 0: chosen by .local_size()
+} ocl_range_t;
+
+// Recorded command graph: kernel enqueues issued on the context between
+// .record() and .end_record() are captured instead of being executed and
+// .replay() enqueues all of them with a single call. Uses
+// cl_khr_command_buffer when device supports it and host side list of
+// pre-validated launches (private kernel instance with bound arguments
+// and final NDRange each) otherwise.
+// Kernel arguments are captured at record time thus memory used by the
+// recorded commands must outlive the graph. Temporary memory of recorded
+// commands (e.g. blast scratch and sub-buffers) is handed to the graph
+// with .own() and deallocated by .discard(). While recording enqueues
+// return null events, profiling is off and map/read/write are fatal
+// (blast operations that read results on host cannot be recorded).
+
+typedef struct ocl_graph_command_s {
+    ocl_kernel_t k; // private kernel instance
+    uint32_t dims;
+    size_t offset[3];
+    size_t global[3];
+    size_t local[3];
+} ocl_graph_command_t;
+
+typedef struct ocl_graph_s {
+    ocl_context_t* c;
+    void* cb; // cl_command_buffer_khr or null for host launch list
+    ocl_graph_command_t* commands; // host launch list
+    int32_t count;    // number of recorded commands
+    int32_t capacity; // of commands[]
+    uint32_t sync;    // last command buffer sync point
+    ocl_memory_t* owned;    // deallocated by .discard() (see .own())
+    int32_t owned_count;
+    int32_t owned_capacity; // of owned[]
+} ocl_graph_t;
+
 enum { // .allocate() access flags (matching OpenCL)
     ocl_allocate_read  = (1 << 2),
     ocl_allocate_write = (1 << 1),
@@ -152,15 +296,63 @@ enum { // .map() access flags (matching OpenCL)
     ocl_map_rw    = ((1 << 0) | (1 << 1)),
 };
 
+// Program binaries cache: .compile_program() looks up
+//     <folder>/ocl_<hash>.bin
+// where hash is FNV-1a 64 of device name, driver version, build options
+// and source code. On miss or if cached binary is rejected by driver
+// (stale) program is built from source and binary is (re)written.
+
+typedef struct ocl_cache_s {
+    const char* folder; // null: %TEMP% (set by .init()), "": disabled
+    int64_t hits;       // programs created from cached binaries
+    int64_t misses;     // programs built from source
+    int64_t stale;      // cached binaries rejected and rebuilt
+    double  build;      // seconds spent building from source
+    double  load;       // seconds spent loading cached binaries
+    double  saved;      // seconds: recorded build time of hits - load
+} ocl_cache_t;
+
 // single device single queue OpenCL interface
 
+// Threads: ocl functions are reentrant and may be called concurrently
+// on different ocl_context_t. A context (its in-order queue) and kernels
+// (arguments are set on the shared kernel object before enqueue) must be
+// used by one thread at a time. Threads that submit concurrently use
+// .fork() of the context (own queue, same OpenCL context, thus memory
+// and programs are shared) and .clone_kernel() instances of the kernels.
+
 typedef struct ocl_if {
     void (*init)(void); // initializes devices[count] array
+    // partitions device "ix" into "parts" equal sub-devices (e.g. CPU
+    // cores) appended to devices[]. Returns number of appended devices,
+    // 0 if device cannot be partitioned (most GPUs).
+    int32_t (*sub_devices)(int32_t ix, int32_t parts);
     void (*dump)(int ix); // dumps device info
     ocl_context_t (*open)(int32_t ix, ocl_override_t* ocl_override);
+    // context with its own in-order queue on the same OpenCL context as
+    // "c" for another host thread. Not profiling. Must be .close()-ed.
+    ocl_context_t (*fork)(const ocl_context_t* c);
     bool (*is_profiling)(ocl_context_t* c);
     // pinned memory with CL_MEM_ALLOC_HOST_PTR
     ocl_memory_t (*allocate)(ocl_context_t* c, int access, size_t bytes);
+    // wraps caller owned page aligned host memory (CL_MEM_USE_HOST_PTR)
+    // without copying. "data" must stay valid until .deallocate().
+    // Devices with unified_memory access it in place (zero-copy), discrete
+    // devices may cache it in device memory (.map()/.unmap() synchronize)
+    ocl_memory_t (*wrap)(ocl_context_t* c, int access, void* data,
+        size_t bytes);
+    // sub-buffer (clCreateSubBuffer) of "bytes" at "offset" of "m" that
+    // kernels see as a separate buffer starting at index 0. Offset must be
+    // a multiple of devices[].base_align. Inherits access flags of "m",
+    // must be deallocated before "m".
+    ocl_memory_t (*sub_buffer)(ocl_context_t* c, ocl_memory_t m,
+        size_t offset, size_t bytes);
+    // Shared Virtual Memory (OpenCL 2.0+): fine grained when device svm
+    // has ocl_svm_fine_grain_buffer (host and kernels access the same
+    // address without map/unmap, coherent at synchronization points),
+    // coarse grained otherwise. Passed to kernels as {p, ocl_arg_svm}.
+    void* (*svm_alloc)(ocl_context_t* c, int access, size_t bytes);
+    void  (*svm_free)(ocl_context_t* c, void* p);
     void (*flush)(ocl_context_t* c); // all queued command to GPU
     void (*finish)(ocl_context_t* c); // waits for all commands to finish
     void (*deallocate)(ocl_memory_t m);
@@ -170,8 +362,31 @@ typedef struct ocl_if {
         size_t offset, size_t bytes);
     // memory must be unmapped before the kernel is executed
     void (*unmap)(ocl_context_t* c, ocl_memory_t m, const void* address);
+    // Non-blocking variants of the above and of buffer reads/writes.
+    // Commands do not start before "count" events in "after" completed
+    // (count can be 0) and return completion event (caller must release).
+    // Mapped address and host "data" must not be accessed by host until
+    // the completion event is complete.
+    void* (*map_async)(ocl_context_t* c, int mapping, ocl_memory_t m,
+        size_t offset, size_t bytes, int count, ocl_event_t after[],
+        ocl_event_t* done);
+    ocl_event_t (*unmap_async)(ocl_context_t* c, ocl_memory_t m,
+        const void* address, int count, ocl_event_t after[]);
+    // device memory -> host "data" (clEnqueueReadBuffer)
+    ocl_event_t (*read)(ocl_context_t* c, ocl_memory_t m, size_t offset,
+        size_t bytes, void* data, int count, ocl_event_t after[]);
+    // host "data" -> device memory (clEnqueueWriteBuffer)
+    ocl_event_t (*write)(ocl_context_t* c, ocl_memory_t m, size_t offset,
+        size_t bytes, const void* data, int count, ocl_event_t after[]);
     ocl_program_t (*compile_program)(ocl_context_t* c, const char* code,
         size_t bytes, const char* options);
+    // starts building program on a host thread and returns immediately
+    // "code" must stay valid until .program() returns
+    ocl_build_t (*compile_program_async)(ocl_context_t* c, const char* code,
+        size_t bytes, const char* options);
+    // waits for the build to finish (fatal on build errors) and
+    // disposes the build handle
+    ocl_program_t (*program)(ocl_build_t b);
     ocl_kernel_t (*create_kernel)(ocl_program_t p, const char* name);
     void (*kernel_info)(ocl_context_t* c, ocl_kernel_t kernel,
         ocl_kernel_info_t* info);
@@ -179,11 +394,56 @@ typedef struct ocl_if {
     ocl_event_t (*enqueue_range_kernel)(ocl_context_t* c, ocl_kernel_t k,
         size_t groups, size_t items,
         int argc, ocl_arg_t argv[]);
+    // same as above but kernel will not start before all "after" events
+    // completed (count can be 0)
+    ocl_event_t (*enqueue_range_kernel_after)(ocl_context_t* c, ocl_kernel_t k,
+        size_t groups, size_t items,
+        int argc, ocl_arg_t argv[], int count, ocl_event_t after[]);
+    // fills zero local[] sizes of the range for kernel "k" using kernel
+    // work-group limit, preferred work-group multiple and max_items[]
+    void (*local_size)(ocl_context_t* c, ocl_kernel_t k, ocl_range_t* r);
+    // 1, 2 or 3 dimensional range kernel (see ocl_range_t), zero local
+    // sizes are chosen automatically. If the range is split the returned
+    // event is the last enqueued one (the queue is in-order)
+    ocl_event_t (*enqueue_ndrange_kernel)(ocl_context_t* c, ocl_kernel_t k,
+        const ocl_range_t* r, int argc, ocl_arg_t argv[],
+        int count, ocl_event_t after[]);
+    // binds kernel, NDRange and all arguments once
+    ocl_launch_t (*prepare)(ocl_context_t* c, ocl_kernel_t k,
+        size_t groups, size_t items, int argc, ocl_arg_t argv[]);
+    // rebinds single argument "i" of prepared launch
+    void (*bind)(ocl_launch_t* l, int i, ocl_arg_t arg);
+    // enqueues prepared launch and returns completion event
+    ocl_event_t (*launch)(ocl_launch_t* l);
+    // enqueues prepared launch without creating completion event
+    // (not in profiling[], only in profiler, use .finish() to wait)
+    void (*fire)(ocl_launch_t* l);
+    void (*unprepare)(ocl_launch_t* l);
+    // new kernel instance of the same program and function as "k"
+    // (arguments are not copied), release with .release_kernel()
+    ocl_kernel_t (*clone_kernel)(ocl_kernel_t k);
+    // starts capturing kernel enqueues of "c" into "g" (see ocl_graph_t)
+    void (*record)(ocl_context_t* c, ocl_graph_t* g);
+    void (*end_record)(ocl_graph_t* g);
+    // enqueues all recorded commands, returns completion event of the last
+    ocl_event_t (*replay)(ocl_graph_t* g);
+    void (*discard)(ocl_graph_t* g); // releases recorded commands
+    // memory "m" used by recorded commands is deallocated by .discard()
+    void (*own)(ocl_graph_t* g, ocl_memory_t m);
     void (*wait)(ocl_event_t* events, int count);
+    // non-blocking poll: true if event command completed
+    bool (*is_complete)(ocl_event_t e);
     // appends queued event to array of profiling events;
     ocl_profiling_t* (*profile_add)(ocl_context_t* c, ocl_event_t e);
     // must wait(&p->e, 1) or call .finish() before calling profile(p)
     void (*profile)(ocl_profiling_t* p);
+    // copies aggregated statistics of up to "count" profiled kernels
+    // into s[] and returns number of kernels copied (zero if no profiler).
+    // Events that already completed are aggregated before copying.
+    int32_t (*stats)(ocl_context_t* c, ocl_kernel_stats_t s[], int32_t count);
+    // statistics of kernel function "name", false if never profiled
+    bool (*stats_of)(ocl_context_t* c, const char* name, ocl_kernel_stats_t* s);
+    void (*stats_reset)(ocl_context_t* c); // forgets all resolved samples
     void (*retain_event)(ocl_event_t e);  // reference counter++
     void (*release_event)(ocl_event_t e); // reference counter--
     const char* (*error)(int result);
@@ -192,6 +452,7 @@ typedef struct ocl_if {
     void (*close)(ocl_context_t* c);
     ocl_device_t* devices;
     int32_t count;
+    ocl_cache_t cache;
 } ocl_if;
 
 extern ocl_if ocl;
@@ -224,6 +485,8 @@ extern ocl_if ocl;
   that all work-items have completed their previous work-items before
   continuing execution.
 
-  enqueue_range_kernel is 1-dimensional version of clEnqueueNDRangeKernel.
-  enqueue_range_kernel_2D/3D can be exposed if needed.
+  enqueue_range_kernel is 1-dimensional version of clEnqueueNDRangeKernel
+  expressed in groups and items. enqueue_ndrange_kernel is 1D/2D/3D version
+  with global offsets, automatic local sizes and global sizes that are not
+  multiples of local sizes.
 */
\ No newline at end of file
@@ -90,6 +90,156 @@ static void x_add_y(ocl_context_t* c, ocl_kernel_t k,
     }
 }
 
+static void enqueue_latency(ocl_context_t* c, ocl_kernel_t k,
+                            ocl_memory_t mx, ocl_memory_t my,
+                            ocl_memory_t mz, int64_t n) {
+    // host time of a single enqueue of small NDRange: setting all
+    // arguments and creating completion event vs prepared launch that
+    // rebinds a single argument and does not create an event
+    enum { K = 1024 }; // enqueues
+    ocl_arg_t args[] =
+        {{&mx, sizeof(ocl_memory_t)},
+         {&my, sizeof(ocl_memory_t)},
+         {&mz, sizeof(ocl_memory_t)}
+    };
+    int64_t items = min(n, ocl.devices[c->ix].max_items[0]);
+    ocl.finish(c);
+    double plain = seconds();
+    for (int i = 0; i < K; i++) {
+        ocl_event_t e = ocl.enqueue_range_kernel(c, k, 1, items,
+            countof(args), args);
+        ocl.release_event(e);
+    }
+    plain = (seconds() - plain) / K;
+    ocl.finish(c);
+    ocl_launch_t l = ocl.prepare(c, k, 1, items, countof(args), args);
+    double prepared = seconds();
+    for (int i = 0; i < K; i++) {
+        ocl.bind(&l, 2, args[2]);
+        ocl.fire(&l);
+    }
+    prepared = (seconds() - prepared) / K;
+    ocl.finish(c);
+    ocl.unprepare(&l);
+    traceln("enqueue latency: %6.3f prepared: %6.3f (microsec)",
+            plain * USEC_IN_SEC, prepared * USEC_IN_SEC);
+}
+
+static void stream_timeline(ocl_context_t* c, int batches, int depth,
+                            double wall) {
+    // 4 profiled commands per batch: write x, write y, kernel, map z
+    ocl_profiling_t* p = c->ov->profiling;
+    for (int i = 0; i < c->ov->profiling_count; i++) { ocl.profile(&p[i]); }
+    const uint64_t t0 = p[0].start;
+    uint64_t end = t0;
+    double idle = 0;
+    traceln("depth: %d (microsec from first write)", depth);
+    for (int b = 0; b < batches; b++) {
+        const ocl_profiling_t* q = &p[b * 4];
+        // device idle between previous batch and this one: host was filling
+        // inputs and the queue was starved
+        const double gap = q[0].start > end ?
+            (q[0].start - end) / (double)NSEC_IN_SEC : 0;
+        idle += gap;
+        traceln("%2d write: %8.1f..%8.1f kernel: %8.1f..%8.1f "
+                "map: %8.1f..%8.1f idle: %7.1f", b,
+                (q[0].start - t0) / 1e3, (q[1].end - t0) / 1e3,
+                (q[2].start - t0) / 1e3, (q[2].end - t0) / 1e3,
+                (q[3].start - t0) / 1e3, (q[3].end - t0) / 1e3,
+                gap * USEC_IN_SEC);
+        end = q[3].end;
+    }
+    traceln("depth: %d wall: %.3f device idle: %.3f (ms)", depth,
+            wall * MSEC_IN_SEC, idle * MSEC_IN_SEC);
+}
+
+static void stream(ocl_context_t* c, ocl_kernel_t k, int64_t n, int depth) {
+    // Streams batches of x + y through "depth" sets of buffers.
+    // depth 1: host fills the next batch only after the previous result
+    // was read back (host and device take turns).
+    // depth 2: double buffering - host fills inputs of batch i while
+    // device is still busy with batch i - 1, all commands are non-blocking
+    // (write, kernel after writes, map after kernel) and host waits only
+    // for the results of batch i - 2 before reusing its buffers.
+    enum { batches = 16 };
+    assert(1 <= depth && depth <= 2);
+    const size_t bytes = n * sizeof(float);
+    ocl_memory_t mx[2], my[2], mz[2];
+    float* hx[2]; // host staging of inputs
+    float* hy[2];
+    float* z[2] = {null, null}; // mapped results
+    ocl_event_t mapped[2] = {null, null};
+    int batch[2] = {0, 0};
+    for (int s = 0; s < depth; s++) {
+        mx[s] = ocl.allocate(c, ocl_allocate_write, bytes);
+        my[s] = ocl.allocate(c, ocl_allocate_write, bytes);
+        mz[s] = ocl.allocate(c, ocl_allocate_read,  bytes);
+        hx[s] = (float*)malloc(bytes);
+        hy[s] = (float*)malloc(bytes);
+        fatal_if(hx[s] == null || hy[s] == null);
+    }
+    int64_t max_items  = ocl.devices[c->ix].max_items[0];
+    int64_t groups = (n + max_items - 1) / max_items;
+    int64_t items  = (n + groups - 1) / groups;
+    assert(groups * items == n);
+    if (ocl.is_profiling(c)) { c->ov->profiling_count = 0; }
+    double wall = seconds();
+    for (int i = 0; i < batches + depth; i++) {
+        const int s = i % depth;
+        if (mapped[s] != null) { // results of batch i - depth
+            ocl.wait(&mapped[s], 1);
+            ocl.release_event(mapped[s]);
+            mapped[s] = null;
+            for (int32_t j = 0; j < n; j++) {
+                fatal_if(z[s][j] != (float)(n + batch[s]), "z[%d]: %.1f",
+                         j, z[s][j]);
+            }
+            ocl.release_event(ocl.unmap_async(c, mz[s], z[s], 0, null));
+        }
+        if (i < batches) {
+            // with depth 2 this overlaps with the kernel of batch i - 1
+            for (int32_t j = 0; j < n; j++) {
+                hx[s][j] = (float)(j + i);
+                hy[s][j] = (float)(n - j);
+            }
+            batch[s] = i;
+            ocl_event_t w[2] = {
+                ocl.write(c, mx[s], 0, bytes, hx[s], 0, null),
+                ocl.write(c, my[s], 0, bytes, hy[s], 0, null)
+            };
+            ocl_arg_t args[] =
+                {{&mx[s], sizeof(ocl_memory_t)},
+                 {&my[s], sizeof(ocl_memory_t)},
+                 {&mz[s], sizeof(ocl_memory_t)}
+            };
+            ocl_event_t e = ocl.enqueue_range_kernel_after(c, k, groups, items,
+                countof(args), args, countof(w), w);
+            z[s] = (float*)ocl.map_async(c, ocl_map_read, mz[s], 0, bytes,
+                1, &e, &mapped[s]);
+            if (ocl.is_profiling(c)) {
+                ocl.profile_add(c, w[0]);
+                ocl.profile_add(c, w[1]);
+                ocl.profile_add(c, e);
+                ocl.profile_add(c, mapped[s]);
+            }
+            ocl.release_event(w[0]);
+            ocl.release_event(w[1]);
+            ocl.release_event(e);
+            ocl.flush(c); // start device work before host fills next batch
+        }
+    }
+    ocl.finish(c); // last unmap
+    wall = seconds() - wall;
+    if (ocl.is_profiling(c)) { stream_timeline(c, batches, depth, wall); }
+    for (int s = 0; s < depth; s++) {
+        free(hy[s]);
+        free(hx[s]);
+        ocl.deallocate(mz[s]);
+        ocl.deallocate(my[s]);
+        ocl.deallocate(mx[s]);
+    }
+}
+
 #define kernel_name "x_add_y"
 
 static int test(ocl_context_t* c, int64_t n) {
@@ -107,6 +257,9 @@ static int test(ocl_context_t* c, int64_t n) {
     ocl_memory_t my = ocl.allocate(c, ocl_allocate_write, n * sizeof(float));
     ocl_memory_t mz = ocl.allocate(c, ocl_allocate_read,  n * sizeof(float));
     x_add_y(c, k, mx, my, mz, n, true);
+    enqueue_latency(c, k, mx, my, mz, n);
+    stream(c, k, n, 1);
+    stream(c, k, n, 2);
     enum { M = 128 }; // measurements
     for (int i = 0; i < M; i++) {
         x_add_y(c, k, mx, my, mz, n, false);
@@ -8,6 +8,7 @@
 // with exact ordering:
 
 static_assert(blast_fpp16 == 0 && blast_fpp32 == 1 && blast_fpp64 == 2, "order");
+static_assert(blast_q8 == 0 && blast_q4 == 1, "order");
 
 const char* blast_fpp_names[3] = {"fp16", "fp32", "fp64"};
 
@@ -15,6 +16,11 @@ const int blast_fpp_bytes[3] = {
     (int)sizeof(fp16_t), (int)sizeof(fp32_t), (int)sizeof(fp64_t)
 };
 
+const char* blast_q_names[2] = {"q8", "q4"};
+
+// partial sums of fp16_t are accumulated in fp32_t (see acc_t in blast.cl)
+static const int blast_acc_fpp[3] = { blast_fpp32, blast_fpp32, blast_fpp64 };
+
 static_assert(blast_access_read  == 0, "order");
 static_assert(blast_access_write == 1, "order");
 static_assert(blast_access_rw    == 2, "order");
@@ -32,8 +38,7 @@ static int blast_map_access_to_ocl[] = {
 };
 
 static blast_memory_t blast_allocate(blast_t* b, int access, int64_t bytes) {
-    blast_memory_t gm;
-    gm.m = null;
+    blast_memory_t gm = {0};
     gm.b = b;
     gm.s = bytes;
     gm.h = ocl.allocate(b->c, blast_alloc_access_to_ocl[access], bytes);
@@ -41,14 +46,170 @@ static blast_memory_t blast_allocate(blast_t* b, int access, int64_t bytes) {
     return gm;
 }
 
+static blast_memory_t blast_wrap(blast_t* b, int access, void* data,
+        int64_t bytes) {
+    blast_memory_t gm = {0};
+    gm.b = b;
+    gm.s = bytes;
+    gm.h = ocl.wrap(b->c, blast_alloc_access_to_ocl[access], data, bytes);
+    return gm;
+}
+
+// Fine grained SVM is the same virtual address for host and kernels:
+// h is the address itself and map()/unmap() do not enqueue any commands.
+
+static blast_memory_t blast_allocate_svm(blast_t* b, int access,
+        int64_t bytes) {
+    const ocl_device_t* d = &ocl.devices[b->c->ix];
+    fatal_if((d->svm & ocl_svm_fine_grain_buffer) == 0,
+             "%s does not support fine grained SVM", d->name);
+    blast_memory_t gm = {0};
+    gm.svm = true;
+    gm.b = b;
+    gm.s = bytes;
+    gm.h = ocl.svm_alloc(b->c, blast_alloc_access_to_ocl[access], bytes);
+    return gm;
+}
+
 static void blast_deallocate(blast_memory_t* bm) {
 //  traceln("%p: %p", bm->h, bm->m);
-    ocl.deallocate((ocl_memory_t)bm->h);
-    memset(bm, 0, sizeof(bm));
+    if (bm->svm) {
+        ocl.svm_free(bm->b->c, bm->h);
+    } else {
+        ocl.deallocate((ocl_memory_t)bm->h);
+    }
+    memset(bm, 0, sizeof(*bm));
+}
+
+static ocl_arg_t blast_arg(blast_memory_t* gm) {
+    return gm->svm ? (ocl_arg_t){gm->h, ocl_arg_svm} :
+                     (ocl_arg_t){&gm->h, sizeof(ocl_memory_t)};
+}
+
+static blast_memory_t blast_view(blast_memory_t* gm, int64_t offset,
+        int64_t bytes) {
+    fatal_if(offset < 0 || bytes <= 0 || offset + bytes > gm->s,
+             "offset: %lld bytes: %lld size: %lld", offset, bytes, gm->s);
+    fatal_if(gm->svm, "SVM memory cannot have sub-buffer views");
+    blast_memory_t v = {0};
+    v.b = gm->b;
+    v.s = bytes;
+    v.root = gm->root != null ? gm->root : gm->h;
+    v.origin = gm->origin + offset;
+    v.h = ocl.sub_buffer(gm->b->c, (ocl_memory_t)v.root, v.origin, bytes);
+    return v;
+}
+
+// Unit stride vectors at aligned offsets use compact kernels on temporary
+// sub-buffer views instead of offset + stride kernels (extra index math
+// per element). Views are released right after enqueue: OpenCL keeps
+// memory objects alive until commands that use them complete.
+
+static bool blast_viewable(blast_memory_t* v, int64_t o, int64_t s, int fpp) {
+    const int64_t align = ocl.devices[v->b->c->ix].base_align;
+    return s == 1 && (v->svm || (o * blast_fpp_bytes[fpp]) % align == 0);
+}
+
+static blast_memory_t blast_view_of(blast_memory_t* v, int64_t o, int64_t n,
+        int fpp) { // returns *v itself for zero offset
+    const int64_t bytes = blast_fpp_bytes[fpp];
+    if (o != 0 && v->svm) { // kernels accept any address inside SVM
+        blast_memory_t a = *v;
+        a.h = (uint8_t*)v->h + o * bytes;
+        a.s = n * bytes;
+        return a;
+    }
+    return o == 0 ? *v : blast_view(v, o * bytes, n * bytes);
+}
+
+static void blast_unview(blast_memory_t* view, blast_memory_t* v) {
+    if (view->h != v->h && !view->svm) {
+        ocl_graph_t* g = v->b->c->graph;
+        if (g != null) { // sub-buffer is referenced by recorded command
+            ocl.own(g, (ocl_memory_t)view->h);
+            memset(view, 0, sizeof(*view));
+        } else {
+            blast_deallocate(view);
+        }
+    }
+}
+
+static void blast_kernels(blast_t* b, int fpp); // see blast_init()
+
+// Scratch memory pool. Commands are executed in order on a single queue
+// thus buffer released right after enqueue can be handed out again and
+// will only be accessed by commands enqueued later.
+// Recorded commands are executed again on every replay: while recording
+// scratch is not pooled, it is owned by the graph (see ocl.own()) and
+// .release() of it is a no-op.
+
+enum { blast_pool_min_log2 = 6 }; // smallest size class is 64 bytes
+
+static int blast_pool_class(int64_t bytes) {
+    int k = 0;
+    while ((1LL << (k + blast_pool_min_log2)) < bytes) { k++; }
+    return k;
+}
+
+static blast_memory_t blast_scratch(blast_t* b, int64_t bytes) {
+    blast_pool_t* p = &b->pool;
+    if (b->c->graph != null) {
+        blast_memory_t gm = blast_allocate(b, blast_access_rw, bytes);
+        ocl.own(b->c->graph, (ocl_memory_t)gm.h);
+        gm.recorded = true;
+        return gm;
+    }
+    const int k = blast_pool_class(bytes);
+    if (k >= blast_pool_classes) { // too big to be pooled
+        p->misses++;
+        return blast_allocate(b, blast_access_rw, bytes);
+    }
+    blast_memory_t gm = {0};
+    gm.b = b;
+    gm.s = 1LL << (k + blast_pool_min_log2);
+    if (p->count[k] > 0) {
+        gm.h = p->free[k][--p->count[k]];
+        p->bytes -= gm.s;
+        p->hits++;
+    } else {
+        gm.h = ocl.allocate(b->c, ocl_allocate_rw, gm.s);
+        p->misses++;
+    }
+    return gm;
+}
+
+static void blast_release(blast_memory_t* bm) {
+    if (bm->recorded) { memset(bm, 0, sizeof(*bm)); return; } // graph owns
+    blast_pool_t* p = &bm->b->pool;
+    const int k = blast_pool_class(bm->s);
+    if (k < blast_pool_classes && bm->s == (1LL << (k + blast_pool_min_log2)) &&
+        p->count[k] < blast_pool_depth) {
+        p->free[k][p->count[k]++] = bm->h;
+        p->bytes += bm->s;
+        memset(bm, 0, sizeof(*bm));
+    } else {
+        blast_deallocate(bm);
+    }
+}
+
+static void blast_trim(blast_t* b, int64_t keep) {
+    blast_pool_t* p = &b->pool;
+    // largest size classes go first
+    for (int k = blast_pool_classes - 1; k >= 0 && p->bytes > keep; k--) {
+        while (p->count[k] > 0 && p->bytes > keep) {
+            ocl.deallocate((ocl_memory_t)p->free[k][--p->count[k]]);
+            p->free[k][p->count[k]] = null;
+            p->bytes -= 1LL << (k + blast_pool_min_log2);
+        }
+    }
 }
 
 static void* blast_map(blast_memory_t* bm, int access, int64_t offset,
         int64_t bytes) {
+    if (bm->svm) { // no commands, caller waits for futures writing it
+        bm->m = (uint8_t*)bm->h + offset;
+        return bm->m;
+    }
     bm->m = ocl.map(bm->b->c, blast_map_access_to_ocl[access],
         (ocl_memory_t)bm->h, offset, bytes);
 //  traceln("%p: %p", bm->h, bm->m);
@@ -57,7 +218,7 @@ static void* blast_map(blast_memory_t* bm, int access, int64_t offset,
 
 static void blast_unmap(blast_memory_t* bm) {
 //  traceln("%p: %p", bm->h, bm->m);
-    ocl.unmap(bm->b->c, (ocl_memory_t)bm->h, bm->m);
+    if (!bm->svm) { ocl.unmap(bm->b->c, (ocl_memory_t)bm->h, bm->m); }
     bm->m = null;
 }
 
@@ -83,9 +244,9 @@ static void blast_dot_compact(int64_t groups, int64_t items,
     blast_t* b = v0->b;
     ocl_context_t* c = b->c;
     ocl_arg_t args[] = {
-        {&v0->h, sizeof(ocl_memory_t)},
-        {&v1->h, sizeof(ocl_memory_t)},
-        {&r->h,  sizeof(ocl_memory_t)}
+        blast_arg(v0),
+        blast_arg(v1),
+        blast_arg(r)
     };
     double user = ocl.is_profiling(c) ? seconds() : 0;
     ocl_event_t e = ocl.enqueue_range_kernel(c,
@@ -107,13 +268,13 @@ static void blast_dot_strided(int64_t groups, int64_t items,
     blast_t* b = v0->b;
     ocl_context_t* c = b->c;
     ocl_arg_t args[] = {
-        {&v0->h, sizeof(ocl_memory_t)},
+        blast_arg(v0),
         {&o0,    sizeof(int32_t)},
         {&s0,    sizeof(int32_t)},
-        {&v1->h, sizeof(ocl_memory_t)},
+        blast_arg(v1),
         {&o1,    sizeof(int32_t)},
         {&s1,    sizeof(int32_t)},
-        {&r->h,  sizeof(ocl_memory_t)}
+        blast_arg(r)
     };
     double user = ocl.is_profiling(c) ? seconds() : 0;
     ocl_event_t e = ocl.enqueue_range_kernel(c, b->dot_os[fpp],
@@ -154,7 +315,7 @@ static fp64_t sum_and_finish(blast_memory_t* v, int64_t items, int64_t groups, i
         int64_t n = ne;
         int64_t m = n / 2;
         int64_t bytes = ne * blast_fpp_bytes[fpp] / 2; // odd "ne" truncated
-        blast_memory_t  s = blast.allocate(v->b, blast_access_read, bytes);
+        blast_memory_t  s = blast.scratch(v->b, bytes);
         blast_memory_t* v0 = v;
         blast_memory_t* v1 = &s;
         const int64_t max_items  = ocl.devices[c->ix].max_items[0];
@@ -170,8 +331,8 @@ static fp64_t sum_and_finish(blast_memory_t* v, int64_t items, int64_t groups, i
             }
             assertion(groups * items == m);
             ocl_arg_t args[] = {
-                {&v0->h,  sizeof(ocl_memory_t)},
-                {&v1->h,  sizeof(ocl_memory_t)}
+                blast_arg(v0),
+                blast_arg(v1)
             };
             ocl_kernel_t k = n % 2 == 0 ? b->sum_even[fpp] : b->sum_odd[fpp];
             double user = ocl.is_profiling(c) ? seconds() : 0;
@@ -192,18 +353,17 @@ static fp64_t sum_and_finish(blast_memory_t* v, int64_t items, int64_t groups, i
         }
         ocl.finish(c); // same as waiting for chain of events
         sum = read_1xfp_from_memory(v0, fpp);
-        blast.deallocate(&s);
+        blast.release(&s);
     }
     return sum;
 }
 
-static fp64_t blast_dot(
+static fp64_t blast_dot_chain(
         blast_memory_t* v0, int64_t o0, int64_t s0,
         blast_memory_t* v1, int64_t o1, int64_t s1, int64_t n,
-        int fpp) { // blast_fpp16, blast_fpp32, blast_fpp64
-    fatal_if(v0->b != v1->b, "foreign vectors");
-    fatal_if(fpp < blast_fpp16 || blast_fpp64 < fpp, "fpp: %d", fpp);
+        int fpp) {
     blast_t* b = v0->b;
+    blast_kernels(b, fpp);
     ocl_context_t* c = b->c;
     fp64_t s = 0;
     const int64_t max_groups = ocl.devices[c->ix].max_groups;
@@ -211,9 +371,6 @@ static fp64_t blast_dot(
     // sum relies on max_* being power of 2
     assert((max_items  & (max_items  - 1)) == 0);
     assert((max_groups & (max_groups - 1)) == 0);
-    if (ocl.is_profiling(c)) {
-        c->ov->profiling_count = 0;
-    }
     size_t bytes = blast_fpp_bytes[fpp];
     while (n > 0) {
         int64_t groups = min((n + max_items - 1) / max_items, max_groups);
@@ -223,19 +380,267 @@ static fp64_t blast_dot(
         int64_t items = ne / groups;
         assertion(items > 0 && groups > 0 && items * groups <= n);
         assertion(ne == groups * items);
-        blast_memory_t r = blast.allocate(b, blast_access_read, ne * bytes);
-        if (o0 == 0 && s0 == 1 && o1 == 0 && s1 == 1) {
-            blast_dot_compact(groups, items, v0, v1, &r, fpp);
+        blast_memory_t r = blast.scratch(b, ne * bytes);
+        if (blast_viewable(v0, o0, s0, fpp) && blast_viewable(v1, o1, s1, fpp)) {
+            blast_memory_t w0 = blast_view_of(v0, o0, ne, fpp);
+            blast_memory_t w1 = blast_view_of(v1, o1, ne, fpp);
+            blast_dot_compact(groups, items, &w0, &w1, &r, fpp);
+            blast_unview(&w1, v1);
+            blast_unview(&w0, v0);
         } else {
 //          traceln("offsets: %8lld %8lld strides: %lld %lld ne: %8lld", o0, o1, s0, s1, ne);
             blast_dot_strided(groups, items, v0, o0, s0, v1, o1, s1, &r, fpp);
         }
         s += sum_and_finish(&r, items, groups, fpp);
-        blast.deallocate(&r);
+        blast.release(&r);
         n  -= ne;
         o0 += ne * s0;
         o1 += ne * s1;
     }
+    return s;
+}
+
+// enqueues kernel that will start after "after" event (can be null)
+// returns completion event that the caller must release
+
+static ocl_event_t blast_enqueue(blast_t* b, ocl_kernel_t k,
+        int64_t groups, int64_t items, int argc, ocl_arg_t argv[],
+        int64_t count, int64_t fops, int64_t i32ops, ocl_event_t after) {
+    ocl_context_t* c = b->c;
+    double user = ocl.is_profiling(c) ? seconds() : 0;
+    ocl_event_t e = ocl.enqueue_range_kernel_after(c, k, groups, items,
+        argc, argv, after != null ? 1 : 0, after != null ? &after : null);
+    user = ocl.is_profiling(c) ? (seconds() - user) : 0;
+    if (ocl.is_profiling(c)) {
+        ocl_profiling_t* p = ocl.profile_add(c, e);
+        p->user = user;
+        p->count = count;
+        p->fops = fops;
+        p->i32ops = i32ops;
+    }
+    return e;
+}
+
+static ocl_event_t blast_enqueue_range(blast_t* b, ocl_kernel_t k,
+        const ocl_range_t* r, int argc, ocl_arg_t argv[],
+        int64_t count, int64_t fops, int64_t i32ops, ocl_event_t after) {
+    ocl_context_t* c = b->c;
+    double user = ocl.is_profiling(c) ? seconds() : 0;
+    ocl_event_t e = ocl.enqueue_ndrange_kernel(c, k, r, argc, argv,
+        after != null ? 1 : 0, after != null ? &after : null);
+    user = ocl.is_profiling(c) ? (seconds() - user) : 0;
+    if (ocl.is_profiling(c)) {
+        ocl_profiling_t* p = ocl.profile_add(c, e);
+        p->user = user;
+        p->count = count;
+        p->fops = fops;
+        p->i32ops = i32ops;
+    }
+    return e;
+}
+
+// Launch planner for grid-stride kernels: any "n" is covered by a single
+// NDRange of a bounded persistent grid (a few work-groups per compute unit)
+// and the grid-stride loop inside the kernel covers the rest of elements.
+// Thus scratch memory (one partial per group) does not grow with "n".
+// Note: ocl_device_t.max_groups is CL_DEVICE_MAX_WORK_GROUP_SIZE (items
+// limit) and only caps the number of groups here (tests override it).
+
+// Tuned shapes (see blast.tune()) replace default items and groups per
+// compute unit for the problem size bucket when present.
+
+enum { blast_groups_per_unit = 4 };
+
+static int64_t blast_persistent_groups(const ocl_device_t* d,
+        const blast_shape_t* s) {
+    const int64_t per_unit = s->groups > 0 ? s->groups : blast_groups_per_unit;
+    return min(d->max_groups, max(1, d->compute_units * per_unit));
+}
+
+static int64_t blast_tune_bucket(int64_t elements) { // floor(log2(elements))
+    int64_t k = 0;
+    while (k < blast_tune_buckets - 1 && (2LL << k) <= elements) { k++; }
+    return k;
+}
+
+// gemv_mixed() and gemv_q() are not tuned (yet) and use defaults
+static const blast_shape_t blast_default_shape;
+
+static const blast_shape_t* blast_shape(blast_t* b, int op, int fpp,
+        int64_t elements) {
+    return &b->tuning.shape[op][fpp][blast_tune_bucket(elements)];
+}
+
+static blast_launch_t blast_plan(blast_t* b, int64_t n, int fpp) {
+    const ocl_device_t* d = &ocl.devices[b->c->ix];
+    const blast_shape_t* s = blast_shape(b, blast_tune_dot, fpp, n);
+    const int64_t items = s->items > 0 ? s->items : d->max_items[0];
+    blast_launch_t l = {0};
+    l.items  = min(n, min(items, d->max_items[0]));
+    l.groups = min((n + l.items - 1) / l.items, blast_persistent_groups(d, s));
+    l.per_item = (n + l.groups * l.items - 1) / (l.groups * l.items);
+    l.launches = l.groups > 1 ? 2 : 1; // final sum_reduce() for groups > 1
+    // kernels use int32_t indices:
+    fatal_if(n > INT32_MAX - l.groups * l.items, "n: %lld too large", n);
+    return l;
+}
+
+// dot_reduce() leaves one partial sum per work-group in "p" and
+// sum_reduce() finishes them in a single work-group into "r".
+// Two kernel launches and one readback instead of log2(n) + 1 launches.
+// Nothing is waited for: the returned future holds the event of the last
+// kernel and the device memory "r" the result will be written to.
+
+static blast_future_t blast_dot_enqueue(
+        blast_memory_t* v0, int64_t o0, int64_t s0,
+        blast_memory_t* v1, int64_t o1, int64_t s1, int64_t n,
+        int fpp, const blast_future_t* after) {
+    fatal_if(v0->b != v1->b, "foreign vectors");
+    fatal_if(fpp < blast_fpp16 || blast_fpp64 < fpp, "fpp: %d", fpp);
+    fatal_if(o0 + n * s0 > INT32_MAX || o1 + n * s1 > INT32_MAX,
+             "offset + n * stride does not fit into int32_t");
+    blast_t* b = v0->b;
+    blast_kernels(b, fpp);
+    ocl_context_t* c = b->c;
+    const int64_t max_items = ocl.devices[c->ix].max_items[0];
+    const int acc = blast_acc_fpp[fpp];
+    const int64_t acc_bytes = blast_fpp_bytes[acc];
+    blast_future_t f = { .e = null, .fpp = acc };
+    f.r = blast.scratch(b, acc_bytes);
+    if (n <= 0) { // completed future with zero result
+        memset(blast.map(&f.r, blast_access_write, 0, acc_bytes), 0, acc_bytes);
+        blast.unmap(&f.r);
+        return f;
+    }
+    const blast_launch_t l = blast_plan(b, n, fpp);
+    b->launch = l;
+    // single group writes its sum directly to "r"
+    blast_memory_t p = l.groups == 1 ? f.r :
+        blast.scratch(b, l.groups * acc_bytes);
+    int32_t n32 = (int32_t)n;
+    ocl_event_t e = null;
+    ocl_event_t wait = after != null ? after->e : null;
+    if (blast_viewable(v0, o0, s0, fpp) && blast_viewable(v1, o1, s1, fpp)) {
+        blast_memory_t w0 = blast_view_of(v0, o0, n, fpp);
+        blast_memory_t w1 = blast_view_of(v1, o1, n, fpp);
+        ocl_arg_t args[] = {
+            blast_arg(&w0),
+            blast_arg(&w1),
+            blast_arg(&p),
+            {null,   l.items * acc_bytes}, // __local
+            {&n32,   sizeof(int32_t)}
+        };
+        e = blast_enqueue(b, b->dot_reduce[fpp], l.groups, l.items,
+            countof(args), args, n, 2, 0, wait);
+        blast_unview(&w1, v1);
+        blast_unview(&w0, v0);
+    } else {
+        int32_t offset0 = (int32_t)o0, stride0 = (int32_t)s0;
+        int32_t offset1 = (int32_t)o1, stride1 = (int32_t)s1;
+        ocl_arg_t args[] = {
+            blast_arg(v0),
+            {&offset0,  sizeof(int32_t)},
+            {&stride0,  sizeof(int32_t)},
+            blast_arg(v1),
+            {&offset1,  sizeof(int32_t)},
+            {&stride1,  sizeof(int32_t)},
+            blast_arg(&p),
+            {null,      l.items * acc_bytes}, // __local
+            {&n32,      sizeof(int32_t)}
+        };
+        e = blast_enqueue(b, b->dot_reduce_os[fpp], l.groups, l.items,
+            countof(args), args, n, 2, 4, wait);
+    }
+    if (l.groups > 1) {
+        const int64_t k = min(l.groups, max_items);
+        int32_t g32 = (int32_t)l.groups;
+        ocl_arg_t args[] = {
+            blast_arg(&p),
+            blast_arg(&f.r),
+            {null,   k * acc_bytes}, // __local
+            {&g32,   sizeof(int32_t)}
+        };
+        ocl_event_t sum = blast_enqueue(b, b->sum_reduce[fpp], 1, k,
+            countof(args), args, l.groups, 1, 0, e);
+        if (e != null) { ocl.release_event(e); } // null while recording
+        e = sum;
+        // in-order queue: commands enqueued later reusing pooled scratch
+        // will not start before sum_reduce() finished with it
+        blast.release(&p);
+    }
+    f.e = e;
+    return f;
+}
+
+static blast_future_t blast_dot_batched(
+        blast_memory_t* v0, int64_t o0, int64_t s0, int64_t b0,
+        blast_memory_t* v1, int64_t o1, int64_t s1, int64_t b1,
+        blast_memory_t* r,  int64_t offset, int64_t n, int64_t count,
+        int fpp, const blast_future_t* after) {
+    fatal_if(v0->b != v1->b || v0->b != r->b, "foreign vectors");
+    fatal_if(n <= 0 || count <= 0, "n: %lld count: %lld", n, count);
+    fatal_if(o0 + (count - 1) * b0 + n * s0 > INT32_MAX ||
+             o1 + (count - 1) * b1 + n * s1 > INT32_MAX ||
+             offset + count > INT32_MAX,
+             "offset + n * stride does not fit into int32_t");
+    blast_t* b = v0->b;
+    blast_kernels(b, fpp);
+    ocl_context_t* c = b->c;
+    const ocl_device_t* d = &ocl.devices[c->ix];
+    const int64_t acc_bytes = blast_fpp_bytes[blast_acc_fpp[fpp]];
+    // short vectors: a work-group per pair, groups stride over pairs
+    const blast_shape_t* s = blast_shape(b, blast_tune_dot, fpp, n * count);
+    const int64_t tuned = s->items > 0 ? s->items : d->max_items[0];
+    const int64_t items  = min(n, min(tuned, d->max_items[0]));
+    const int64_t groups = min(count, blast_persistent_groups(d, s));
+    int32_t offset0 = (int32_t)o0, stride0 = (int32_t)s0, batch0 = (int32_t)b0;
+    int32_t offset1 = (int32_t)o1, stride1 = (int32_t)s1, batch1 = (int32_t)b1;
+    int32_t ro = (int32_t)offset, n32 = (int32_t)n, k32 = (int32_t)count;
+    ocl_arg_t args[] = {
+        blast_arg(v0),
+        {&offset0, sizeof(int32_t)},
+        {&stride0, sizeof(int32_t)},
+        {&batch0,  sizeof(int32_t)},
+        blast_arg(v1),
+        {&offset1, sizeof(int32_t)},
+        {&stride1, sizeof(int32_t)},
+        {&batch1,  sizeof(int32_t)},
+        blast_arg(r),
+        {&ro,      sizeof(int32_t)},
+        {null,     items * acc_bytes}, // __local
+        {&n32,     sizeof(int32_t)},
+        {&k32,     sizeof(int32_t)}
+    };
+    blast_future_t f = {0};
+    f.fpp = fpp;
+    f.e = blast_enqueue(b, b->dot_batched_k[fpp], groups, items,
+        countof(args), args, n * count, 2, 6,
+        after != null ? after->e : null);
+    ocl.flush(c);
+    return f;
+}
+
+static bool blast_ready(blast_future_t* f) {
+    return f->e == null || ocl.is_complete(f->e);
+}
+
+static fp64_t blast_wait(blast_future_t* f) {
+    fp64_t v = 0;
+    if (f->e != null) {
+        ocl.wait(&f->e, 1);
+        ocl.release_event(f->e);
+        f->e = null;
+    }
+    if (f->r.h != null) {
+        v = read_1xfp_from_memory(&f->r, f->fpp);
+        // recorded result is kept for the next replay
+        if (!f->r.recorded) { blast.release(&f->r); }
+    }
+    return v;
+}
+
+static void blast_profile_summary(ocl_context_t* c) {
+    // collects all profiling events of the operation into profiling[0]
     if (ocl.is_profiling(c) && c->ov->profiling_count) {
         ocl_profiling_t* p = &c->ov->profiling[0];
         ocl.profile(&p[0]);
@@ -244,13 +649,39 @@ static fp64_t blast_dot(
             p[0].time   += p[i].time;
             p[0].user   += p[i].user;
             p[0].gflops += p[i].gflops;
-            p[0].i32ops += p[i].i64ops;
+            p[0].i32ops += p[i].i32ops;
             p[0].i64ops += p[i].i64ops;
         }
-        p->gflops /= c->ov->profiling_count;
-        p->i32ops /= c->ov->profiling_count;
-        p->i64ops /= c->ov->profiling_count;
+        // entries folded by .profile_add() are already summed in p[0]
+        const uint64_t n = c->ov->profiling_count + p[0].merged;
+        p->gflops /= n;
+        p->i32ops /= n;
+        p->i64ops /= n;
     }
+}
+
+static fp64_t blast_dot(
+        blast_memory_t* v0, int64_t o0, int64_t s0,
+        blast_memory_t* v1, int64_t o1, int64_t s1, int64_t n,
+        int fpp) { // blast_fpp16, blast_fpp32, blast_fpp64
+    fatal_if(v0->b != v1->b, "foreign vectors");
+    fatal_if(fpp < blast_fpp16 || blast_fpp64 < fpp, "fpp: %d", fpp);
+    blast_t* b = v0->b;
+    ocl_context_t* c = b->c;
+    fatal_if(c->graph != null, "dot() reads result on host and cannot be "
+             "recorded, use dot_async() and wait() after replay");
+    if (ocl.is_profiling(c)) {
+        c->ov->profiling_count = 0;
+    }
+    fp64_t s = 0;
+    if (b->chain) {
+        s = blast_dot_chain(v0, o0, s0, v1, o1, s1, n, fpp);
+    } else {
+        blast_future_t f = blast_dot_enqueue(v0, o0, s0, v1, o1, s1, n,
+            fpp, null);
+        s = blast_wait(&f);
+    }
+    blast_profile_summary(c);
     return s;
 }
 
@@ -272,13 +703,761 @@ static fp64_t blast_dot_fp64(
     return blast_dot(v0, o0, s0, v1, o1, s1, n, blast_fpp64);
 }
 
+static blast_future_t blast_dot_async(
+        blast_memory_t* v0, int64_t o0, int64_t s0,
+        blast_memory_t* v1, int64_t o1, int64_t s1, int64_t n,
+        int fpp, const blast_future_t* after) {
+    blast_future_t f = blast_dot_enqueue(v0, o0, s0, v1, o1, s1, n,
+        fpp, after);
+    ocl.flush(v0->b->c); // otherwise .ready() may never become true
+    return f;
+}
+
+static blast_future_t blast_dot_async_fp16(
+        blast_memory_t* v0, int64_t o0, int64_t s0,
+        blast_memory_t* v1, int64_t o1, int64_t s1, int64_t n,
+        const blast_future_t* after) {
+    return blast_dot_async(v0, o0, s0, v1, o1, s1, n, blast_fpp16, after);
+}
+
+static blast_future_t blast_dot_async_fp32(
+        blast_memory_t* v0, int64_t o0, int64_t s0,
+        blast_memory_t* v1, int64_t o1, int64_t s1, int64_t n,
+        const blast_future_t* after) {
+    return blast_dot_async(v0, o0, s0, v1, o1, s1, n, blast_fpp32, after);
+}
+
+static blast_future_t blast_dot_async_fp64(
+        blast_memory_t* v0, int64_t o0, int64_t s0,
+        blast_memory_t* v1, int64_t o1, int64_t s1, int64_t n,
+        const blast_future_t* after) {
+    return blast_dot_async(v0, o0, s0, v1, o1, s1, n, blast_fpp64, after);
+}
+
+static blast_future_t blast_dot_batched_fp16(
+        blast_memory_t* v0, int64_t o0, int64_t s0, int64_t b0,
+        blast_memory_t* v1, int64_t o1, int64_t s1, int64_t b1,
+        blast_memory_t* r,  int64_t offset, int64_t n, int64_t count,
+        const blast_future_t* after) {
+    return blast_dot_batched(v0, o0, s0, b0, v1, o1, s1, b1,
+        r, offset, n, count, blast_fpp16, after);
+}
+
+static blast_future_t blast_dot_batched_fp32(
+        blast_memory_t* v0, int64_t o0, int64_t s0, int64_t b0,
+        blast_memory_t* v1, int64_t o1, int64_t s1, int64_t b1,
+        blast_memory_t* r,  int64_t offset, int64_t n, int64_t count,
+        const blast_future_t* after) {
+    return blast_dot_batched(v0, o0, s0, b0, v1, o1, s1, b1,
+        r, offset, n, count, blast_fpp32, after);
+}
+
+static blast_future_t blast_dot_batched_fp64(
+        blast_memory_t* v0, int64_t o0, int64_t s0, int64_t b0,
+        blast_memory_t* v1, int64_t o1, int64_t s1, int64_t b1,
+        blast_memory_t* r,  int64_t offset, int64_t n, int64_t count,
+        const blast_future_t* after) {
+    return blast_dot_batched(v0, o0, s0, b0, v1, o1, s1, b1,
+        r, offset, n, count, blast_fpp64, after);
+}
+
+// gemv_tiled() work-group computes blast_gemv_rows rows at a time, each
+// work-item reads 4 adjacent columns. Vector tile lives in local memory.
+
+enum { blast_gemv_rows = 4 }; // must match gemv_rows in blast.cl
+
+static void blast_gemv_check(blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* v,  int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m, int64_t n) {
+    fatal_if(mx->b != v->b || mx->b != r->b, "foreign memory");
+    fatal_if(m <= 0 || n <= 0 || sm < n || sv < 1,
+             "m: %lld n: %lld stride_m: %lld stride_v: %lld", m, n, sm, sv);
+    fatal_if(om + (m - 1) * sm + n > INT32_MAX || ov + n * sv > INT32_MAX,
+             "offset + n * stride does not fit into int32_t");
+}
+
+static int64_t blast_gemv_plan(blast_t* b, int64_t m, int64_t n,
+        int64_t acc_bytes, const blast_shape_t* s) {
+    // returns vector tile size in elements, "s" tuned shape (see above)
+    const ocl_device_t* d = &ocl.devices[b->c->ix];
+    const int64_t blocks = (m + blast_gemv_rows - 1) / blast_gemv_rows;
+    const int64_t items = s->items > 0 ? s->items : d->max_items[0];
+    blast_launch_t l = {0};
+    l.items  = min((n + 3) / 4, min(items, d->max_items[0]));
+    l.groups = min(blocks, blast_persistent_groups(d, s));
+    l.per_item = (blocks + l.groups - 1) / l.groups * blast_gemv_rows *
+                 ((n + l.items * 4 - 1) / (l.items * 4)) * 4;
+    l.launches = 1;
+    b->launch = l;
+    // vector tile takes up to a quarter of local memory (occupancy)
+    const int64_t budget = d->local_memory / 4 / acc_bytes - l.items;
+    const int64_t tile = min((n + 3) / 4 * 4, budget / 4 * 4);
+    fatal_if(tile < 4, "local_memory: %lld", d->local_memory);
+    return tile;
+}
+
+static blast_future_t blast_gemv_enqueue(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* v,  int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m, int64_t n,
+        int fpp, const blast_future_t* after) {
+    fatal_if(fpp < blast_fpp16 || blast_fpp64 < fpp, "fpp: %d", fpp);
+    blast_gemv_check(mx, om, sm, v, ov, sv, r, m, n);
+    blast_t* b = mx->b;
+    blast_kernels(b, fpp);
+    const int64_t acc_bytes = blast_fpp_bytes[blast_acc_fpp[fpp]];
+    const int64_t tile = blast_gemv_plan(b, m, n, acc_bytes,
+        blast_shape(b, blast_tune_gemv, fpp, m * n));
+    const blast_launch_t* l = &b->launch;
+    int32_t mx_offset = (int32_t)om, row_stride = (int32_t)sm;
+    int32_t offset = (int32_t)ov, stride = (int32_t)sv;
+    int32_t m32 = (int32_t)m, n32 = (int32_t)n, tile32 = (int32_t)tile;
+    ocl_arg_t args[] = {
+        blast_arg(mx),
+        {&mx_offset,  sizeof(int32_t)},
+        {&row_stride, sizeof(int32_t)},
+        blast_arg(v),
+        {&offset,     sizeof(int32_t)},
+        {&stride,     sizeof(int32_t)},
+        blast_arg(r),
+        {&m32,        sizeof(int32_t)},
+        {&n32,        sizeof(int32_t)},
+        {null,        tile * acc_bytes},     // __local vt[tile]
+        {&tile32,     sizeof(int32_t)},
+        {null,        l->items * acc_bytes}  // __local s[items]
+    };
+    blast_future_t f = {0};
+    f.fpp = fpp;
+    f.e = blast_enqueue(b, b->gemv_tiled[fpp], l->groups, l->items,
+        countof(args), args, m * n, 2, 6, after != null ? after->e : null);
+    return f;
+}
+
+static void blast_gemv(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* v,  int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m, int64_t n, int fpp) {
+    ocl_context_t* c = mx->b->c;
+    if (ocl.is_profiling(c)) {
+        c->ov->profiling_count = 0;
+    }
+    blast_future_t f = blast_gemv_enqueue(mx, om, sm, v, ov, sv, r, m, n,
+        fpp, null);
+    blast_wait(&f);
+    blast_profile_summary(c);
+}
+
+static blast_future_t blast_gemv_async(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* v,  int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m, int64_t n,
+        int fpp, const blast_future_t* after) {
+    blast_future_t f = blast_gemv_enqueue(mx, om, sm, v, ov, sv, r, m, n,
+        fpp, after);
+    ocl.flush(mx->b->c);
+    return f;
+}
+
+static void blast_gemv_fp16(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* v,  int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m, int64_t n) {
+    blast_gemv(mx, om, sm, v, ov, sv, r, m, n, blast_fpp16);
+}
+
+static void blast_gemv_fp32(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* v,  int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m, int64_t n) {
+    blast_gemv(mx, om, sm, v, ov, sv, r, m, n, blast_fpp32);
+}
+
+static void blast_gemv_fp64(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* v,  int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m, int64_t n) {
+    blast_gemv(mx, om, sm, v, ov, sv, r, m, n, blast_fpp64);
+}
+
+static blast_future_t blast_gemv_async_fp16(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* v,  int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m, int64_t n,
+        const blast_future_t* after) {
+    return blast_gemv_async(mx, om, sm, v, ov, sv, r, m, n, blast_fpp16, after);
+}
+
+static blast_future_t blast_gemv_async_fp32(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* v,  int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m, int64_t n,
+        const blast_future_t* after) {
+    return blast_gemv_async(mx, om, sm, v, ov, sv, r, m, n, blast_fpp32, after);
+}
+
+static blast_future_t blast_gemv_async_fp64(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* v,  int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m, int64_t n,
+        const blast_future_t* after) {
+    return blast_gemv_async(mx, om, sm, v, ov, sv, r, m, n, blast_fpp64, after);
+}
+
+// gemv_mixed() fp16 matrix, fp16 or fp32 vector, fp32 accumulation,
+// fp16 or fp32 result. Kernel lives in fp32 program because vload_half()
+// and vstore_half() do not require cl_khr_fp16 support.
+
+static blast_future_t blast_gemv_mixed_enqueue(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* v,  int64_t ov, int64_t sv, int vfpp,
+        blast_memory_t* r,  int rfpp, int64_t m, int64_t n,
+        const blast_future_t* after) {
+    fatal_if(vfpp != blast_fpp16 && vfpp != blast_fpp32, "vfpp: %d", vfpp);
+    fatal_if(rfpp != blast_fpp16 && rfpp != blast_fpp32, "rfpp: %d", rfpp);
+    blast_gemv_check(mx, om, sm, v, ov, sv, r, m, n);
+    blast_t* b = mx->b;
+    blast_kernels(b, blast_fpp32);
+    const int64_t acc_bytes = sizeof(fp32_t);
+    const int64_t tile = blast_gemv_plan(b, m, n, acc_bytes, &blast_default_shape);
+    const blast_launch_t* l = &b->launch;
+    int32_t mx_offset = (int32_t)om, row_stride = (int32_t)sm;
+    int32_t offset = (int32_t)ov, stride = (int32_t)sv;
+    int32_t vfpp32 = vfpp, rfpp32 = rfpp;
+    int32_t m32 = (int32_t)m, n32 = (int32_t)n, tile32 = (int32_t)tile;
+    ocl_arg_t args[] = {
+        blast_arg(mx),
+        {&mx_offset,  sizeof(int32_t)},
+        {&row_stride, sizeof(int32_t)},
+        blast_arg(v),
+        {&offset,     sizeof(int32_t)},
+        {&stride,     sizeof(int32_t)},
+        {&vfpp32,     sizeof(int32_t)},
+        blast_arg(r),
+        {&rfpp32,     sizeof(int32_t)},
+        {&m32,        sizeof(int32_t)},
+        {&n32,        sizeof(int32_t)},
+        {null,        tile * acc_bytes},     // __local vt[tile]
+        {&tile32,     sizeof(int32_t)},
+        {null,        l->items * acc_bytes}  // __local s[items]
+    };
+    blast_future_t f = {0};
+    f.fpp = rfpp;
+    f.e = blast_enqueue(b, b->gemv_mixed_k, l->groups, l->items,
+        countof(args), args, m * n, 2, 6, after != null ? after->e : null);
+    return f;
+}
+
+static void blast_gemv_mixed(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* v,  int64_t ov, int64_t sv, int vfpp,
+        blast_memory_t* r,  int rfpp, int64_t m, int64_t n) {
+    ocl_context_t* c = mx->b->c;
+    if (ocl.is_profiling(c)) {
+        c->ov->profiling_count = 0;
+    }
+    blast_future_t f = blast_gemv_mixed_enqueue(mx, om, sm, v, ov, sv, vfpp,
+        r, rfpp, m, n, null);
+    blast_wait(&f);
+    blast_profile_summary(c);
+}
+
+static blast_future_t blast_gemv_mixed_async(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* v,  int64_t ov, int64_t sv, int vfpp,
+        blast_memory_t* r,  int rfpp, int64_t m, int64_t n,
+        const blast_future_t* after) {
+    blast_future_t f = blast_gemv_mixed_enqueue(mx, om, sm, v, ov, sv, vfpp,
+        r, rfpp, m, n, after);
+    ocl.flush(mx->b->c);
+    return f;
+}
+
+// Block quantization: scale = max(|x|) / qmax rounded to fp16_t and
+// q = round(x / scale). qmax is 127 for q8 and 7 for q4 (symmetric).
+
+static void blast_q_check(int q, int64_t m, int64_t n) {
+    fatal_if(q != blast_q8 && q != blast_q4, "q: %d", q);
+    fatal_if(m <= 0 || n <= 0 || n % blast_q_block != 0,
+             "m: %lld n: %lld must be multiple of %d", m, n, blast_q_block);
+}
+
+static int64_t blast_quant_bytes(int q, int64_t m, int64_t n) {
+    return q == blast_q8 ? m * n : m * n / 2;
+}
+
+static int64_t blast_quantized_bytes(int q, int64_t m, int64_t n) {
+    blast_q_check(q, m, n);
+    return blast_quant_bytes(q, m, n) + m * n / blast_q_block * sizeof(fp16_t);
+}
+
+static void blast_quantize(int q, const fp32_t* x, int64_t m, int64_t n,
+        void* packed) {
+    blast_q_check(q, m, n);
+    const int qmax = q == blast_q8 ? 127 : 7;
+    byte_t* quants = (byte_t*)packed;
+    fp16_t* scales = (fp16_t*)(quants + blast_quant_bytes(q, m, n));
+    for (int64_t b = 0; b < m * n / blast_q_block; b++) {
+        const fp32_t* block = x + b * blast_q_block;
+        fp32_t amax = 0;
+        for (int i = 0; i < blast_q_block; i++) {
+            amax = max(amax, fabsf(block[i]));
+        }
+        scales[b] = fp32to16(amax / qmax);
+        const fp32_t scale = fp16to32(scales[b]);
+        for (int i = 0; i < blast_q_block; i++) {
+            const int64_t ix = b * blast_q_block + i;
+            int v = scale == 0 ? 0 : (int)lrintf(block[i] / scale);
+            v = max(-qmax, min(qmax, v));
+            if (q == blast_q8) {
+                quants[ix] = (byte_t)(int8_t)v;
+            } else if (ix % 2 == 0) {
+                quants[ix / 2] = (byte_t)(v + 8);
+            } else {
+                quants[ix / 2] |= (byte_t)((v + 8) << 4);
+            }
+        }
+    }
+}
+
+static fp32_t blast_dequantize_at(int q, const byte_t* quants,
+        const fp16_t* scales, int64_t ix) {
+    const int v = q == blast_q8 ? (int8_t)quants[ix] :
+        ((quants[ix / 2] >> (ix % 2 == 0 ? 0 : 4)) & 0xF) - 8;
+    return fp16to32(scales[ix / blast_q_block]) * v;
+}
+
+static void blast_dequantize(int q, const void* packed, int64_t m, int64_t n,
+        fp32_t* x) {
+    blast_q_check(q, m, n);
+    const byte_t* quants = (const byte_t*)packed;
+    const fp16_t* scales = (const fp16_t*)(quants + blast_quant_bytes(q, m, n));
+    for (int64_t i = 0; i < m * n; i++) {
+        x[i] = blast_dequantize_at(q, quants, scales, i);
+    }
+}
+
+static void blast_gemv_q_reference(int q, const void* packed,
+        int64_t m, int64_t n, const fp32_t* v, fp32_t* r) {
+    blast_q_check(q, m, n);
+    const byte_t* quants = (const byte_t*)packed;
+    const fp16_t* scales = (const fp16_t*)(quants + blast_quant_bytes(q, m, n));
+    for (int64_t i = 0; i < m; i++) {
+        fp64_t sum = 0;
+        for (int64_t j = 0; j < n; j++) {
+            const fp32_t x = blast_dequantize_at(q, quants, scales, i * n + j);
+            sum += (fp64_t)x * (fp64_t)v[j];
+        }
+        r[i] = (fp32_t)sum;
+    }
+}
+
+static blast_future_t blast_gemv_q_enqueue(int q, blast_memory_t* mx,
+        blast_memory_t* v, int64_t ov, int64_t sv,
+        blast_memory_t* r, int64_t m, int64_t n,
+        const blast_future_t* after) {
+    blast_q_check(q, m, n);
+    fatal_if(mx->b != v->b || mx->b != r->b, "foreign memory");
+    fatal_if(mx->s < blast_quantized_bytes(q, m, n), "matrix %lld bytes", mx->s);
+    fatal_if(sv < 1 || m * n > INT32_MAX || ov + n * sv > INT32_MAX,
+             "m * n or offset + n * stride does not fit into int32_t");
+    blast_t* b = mx->b;
+    blast_kernels(b, blast_fpp32);
+    const int64_t acc_bytes = sizeof(fp32_t);
+    const int64_t tile = blast_gemv_plan(b, m, n, acc_bytes, &blast_default_shape);
+    const blast_launch_t* l = &b->launch;
+    int32_t offset = (int32_t)ov, stride = (int32_t)sv;
+    int32_t m32 = (int32_t)m, n32 = (int32_t)n, tile32 = (int32_t)tile;
+    ocl_arg_t args[] = {
+        blast_arg(mx),
+        {&m32,        sizeof(int32_t)},
+        {&n32,        sizeof(int32_t)},
+        blast_arg(v),
+        {&offset,     sizeof(int32_t)},
+        {&stride,     sizeof(int32_t)},
+        blast_arg(r),
+        {null,        tile * acc_bytes},     // __local vt[tile]
+        {&tile32,     sizeof(int32_t)},
+        {null,        l->items * acc_bytes}  // __local s[items]
+    };
+    blast_future_t f = {0};
+    f.fpp = blast_fpp32;
+    f.e = blast_enqueue(b, b->gemv_q_k[q], l->groups, l->items,
+        countof(args), args, m * n, 3, 8, after != null ? after->e : null);
+    return f;
+}
+
+static void blast_gemv_q(int q, blast_memory_t* mx,
+        blast_memory_t* v, int64_t ov, int64_t sv,
+        blast_memory_t* r, int64_t m, int64_t n) {
+    ocl_context_t* c = mx->b->c;
+    if (ocl.is_profiling(c)) {
+        c->ov->profiling_count = 0;
+    }
+    blast_future_t f = blast_gemv_q_enqueue(q, mx, v, ov, sv, r, m, n, null);
+    blast_wait(&f);
+    blast_profile_summary(c);
+}
+
+static blast_future_t blast_gemv_q_async(int q, blast_memory_t* mx,
+        blast_memory_t* v, int64_t ov, int64_t sv,
+        blast_memory_t* r, int64_t m, int64_t n,
+        const blast_future_t* after) {
+    blast_future_t f = blast_gemv_q_enqueue(q, mx, v, ov, sv, r, m, n, after);
+    ocl.flush(mx->b->c);
+    return f;
+}
+
+static void blast_gemv_q8(blast_memory_t* mx,
+        blast_memory_t* v, int64_t ov, int64_t sv,
+        blast_memory_t* r, int64_t m, int64_t n) {
+    blast_gemv_q(blast_q8, mx, v, ov, sv, r, m, n);
+}
+
+static void blast_gemv_q4(blast_memory_t* mx,
+        blast_memory_t* v, int64_t ov, int64_t sv,
+        blast_memory_t* r, int64_t m, int64_t n) {
+    blast_gemv_q(blast_q4, mx, v, ov, sv, r, m, n);
+}
+
+static blast_future_t blast_gemv_q8_async(blast_memory_t* mx,
+        blast_memory_t* v, int64_t ov, int64_t sv,
+        blast_memory_t* r, int64_t m, int64_t n,
+        const blast_future_t* after) {
+    return blast_gemv_q_async(blast_q8, mx, v, ov, sv, r, m, n, after);
+}
+
+static blast_future_t blast_gemv_q4_async(blast_memory_t* mx,
+        blast_memory_t* v, int64_t ov, int64_t sv,
+        blast_memory_t* r, int64_t m, int64_t n,
+        const blast_future_t* after) {
+    return blast_gemv_q_async(blast_q4, mx, v, ov, sv, r, m, n, after);
+}
+
+// gemm() planner: every work-item accumulates wm x wn micro-tile of c in
+// registers (at most blast_gemm_mr x blast_gemm_nr). Micro-tile grows
+// (columns first) until ceil(ts / wn) * ceil(ts / wm) work-items cover
+// the ts x ts tile within requested gemm_tile.items. If it does not fit
+// or two tiles do not fit into local memory the tile side is halved.
+// One work-group per tile of c (not a persistent grid).
+
+enum { blast_gemm_mr = 4, blast_gemm_nr = 4 }; // gemm_mr, gemm_nr in blast.cl
+
+static blast_gemm_tile_t blast_gemm_plan(blast_t* b, int64_t m, int64_t n,
+        int64_t acc_bytes, int32_t micro[2]) {
+    const ocl_device_t* d = &ocl.devices[b->c->ix];
+    blast_gemm_tile_t gt = b->gemm_tile;
+    fatal_if(gt.tile < 1 || gt.items < 1, "gemm_tile: %lld %lld",
+             gt.tile, gt.items);
+    const int64_t items = min(gt.items, d->max_items[0]);
+    int64_t wm = 1;
+    int64_t wn = 1;
+    for (;;) {
+        const int64_t ts = gt.tile;
+        wm = 1;
+        wn = 1;
+        while (((ts + wn - 1) / wn) * ((ts + wm - 1) / wm) > items &&
+               (wm < blast_gemm_mr || wn < blast_gemm_nr)) {
+            if (wn <= wm && wn < blast_gemm_nr) { wn++; } else { wm++; }
+        }
+        const bool fits = ((ts + wn - 1) / wn) * ((ts + wm - 1) / wm) <= items;
+        const int64_t bytes = 2 * ts * ts * acc_bytes;
+        if (ts == 1 || (fits && bytes <= d->local_memory)) { break; }
+        gt.tile /= 2;
+    }
+    gt.items = ((gt.tile + wn - 1) / wn) * ((gt.tile + wm - 1) / wm);
+    micro[0] = (int32_t)wm;
+    micro[1] = (int32_t)wn;
+    const int64_t tiles = ((m + gt.tile - 1) / gt.tile) *
+                          ((n + gt.tile - 1) / gt.tile);
+    blast_launch_t l = {0};
+    l.items  = gt.items;
+    l.groups = tiles;
+    l.per_item = wm * wn;
+    l.launches = 1;
+    b->launch = l;
+    return gt;
+}
+
+static void blast_gemm_check(
+        blast_memory_t* a, int64_t oa, int64_t lda,
+        blast_memory_t* b, int64_t ob, int64_t ldb,
+        blast_memory_t* c, int64_t oc, int64_t ldc,
+        int64_t m, int64_t n, int64_t k) {
+    fatal_if(a->b != b->b || a->b != c->b, "foreign memory");
+    fatal_if(m <= 0 || n <= 0 || k <= 0 || lda < k || ldb < n || ldc < n,
+             "m: %lld n: %lld k: %lld lda: %lld ldb: %lld ldc: %lld",
+             m, n, k, lda, ldb, ldc);
+    fatal_if(oa + (m - 1) * lda + k > INT32_MAX ||
+             ob + (k - 1) * ldb + n > INT32_MAX ||
+             oc + (m - 1) * ldc + n > INT32_MAX,
+             "offset + rows * ld does not fit into int32_t");
+}
+
+static void blast_gemm_enqueue(ocl_kernel_t kernel, int64_t acc_bytes,
+        blast_memory_t* a, int64_t oa, int64_t lda,
+        blast_memory_t* b, int64_t ob, int64_t ldb,
+        blast_memory_t* c, int64_t oc, int64_t ldc,
+        int64_t m, int64_t n, int64_t k) {
+    blast_gemm_check(a, oa, lda, b, ob, ldb, c, oc, ldc, m, n, k);
+    blast_t* bt = a->b;
+    ocl_context_t* ctx = bt->c;
+    if (ocl.is_profiling(ctx)) {
+        ctx->ov->profiling_count = 0;
+    }
+    int32_t micro[2]; // wm x wn elements of c per work-item
+    const blast_gemm_tile_t gt = blast_gemm_plan(bt, m, n, acc_bytes, micro);
+    int32_t oa32 = (int32_t)oa, lda32 = (int32_t)lda;
+    int32_t ob32 = (int32_t)ob, ldb32 = (int32_t)ldb;
+    int32_t oc32 = (int32_t)oc, ldc32 = (int32_t)ldc;
+    int32_t m32 = (int32_t)m, n32 = (int32_t)n, k32 = (int32_t)k;
+    int32_t ts = (int32_t)gt.tile;
+    const int64_t tile_bytes = gt.tile * gt.tile * acc_bytes;
+    ocl_arg_t args[] = {
+        blast_arg(a),
+        {&oa32,  sizeof(int32_t)},
+        {&lda32, sizeof(int32_t)},
+        blast_arg(b),
+        {&ob32,  sizeof(int32_t)},
+        {&ldb32, sizeof(int32_t)},
+        blast_arg(c),
+        {&oc32,  sizeof(int32_t)},
+        {&ldc32, sizeof(int32_t)},
+        {&m32,   sizeof(int32_t)},
+        {&n32,   sizeof(int32_t)},
+        {&k32,   sizeof(int32_t)},
+        {null,   tile_bytes}, // __local as[ts * ts]
+        {null,   tile_bytes}, // __local bs[ts * ts]
+        {&ts,    sizeof(int32_t)},
+        {&micro[0], sizeof(int32_t)},
+        {&micro[1], sizeof(int32_t)}
+    };
+    const ocl_range_t r = {
+        .dims   = 2,
+        .global = { (size_t)((n + ts - 1) / ts * gt.items),
+                    (size_t)((m + ts - 1) / ts) },
+        .local  = { (size_t)gt.items, 1 }
+    };
+    ocl_event_t e = blast_enqueue_range(bt, kernel, &r,
+        countof(args), args, m * n * k, 2, 8, null);
+    if (e != null) { // null while recording (see ocl.record())
+        ocl.wait(&e, 1);
+        ocl.release_event(e);
+    }
+    blast_profile_summary(ctx);
+}
+
+static void blast_gemm(
+        blast_memory_t* a, int64_t oa, int64_t lda,
+        blast_memory_t* b, int64_t ob, int64_t ldb,
+        blast_memory_t* c, int64_t oc, int64_t ldc,
+        int64_t m, int64_t n, int64_t k, int fpp) {
+    blast_kernels(a->b, fpp);
+    blast_gemm_enqueue(a->b->gemm_k[fpp], blast_fpp_bytes[blast_acc_fpp[fpp]],
+        a, oa, lda, b, ob, ldb, c, oc, ldc, m, n, k);
+}
+
+static void blast_gemm_fp16(
+        blast_memory_t* a, int64_t oa, int64_t lda,
+        blast_memory_t* b, int64_t ob, int64_t ldb,
+        blast_memory_t* c, int64_t oc, int64_t ldc,
+        int64_t m, int64_t n, int64_t k) {
+    blast_gemm(a, oa, lda, b, ob, ldb, c, oc, ldc, m, n, k, blast_fpp16);
+}
+
+static void blast_gemm_fp32(
+        blast_memory_t* a, int64_t oa, int64_t lda,
+        blast_memory_t* b, int64_t ob, int64_t ldb,
+        blast_memory_t* c, int64_t oc, int64_t ldc,
+        int64_t m, int64_t n, int64_t k) {
+    blast_gemm(a, oa, lda, b, ob, ldb, c, oc, ldc, m, n, k, blast_fpp32);
+}
+
+static void blast_gemm_fp64(
+        blast_memory_t* a, int64_t oa, int64_t lda,
+        blast_memory_t* b, int64_t ob, int64_t ldb,
+        blast_memory_t* c, int64_t oc, int64_t ldc,
+        int64_t m, int64_t n, int64_t k) {
+    blast_gemm(a, oa, lda, b, ob, ldb, c, oc, ldc, m, n, k, blast_fpp64);
+}
+
+static void blast_gemm_mixed(
+        blast_memory_t* a, int64_t oa, int64_t lda,
+        blast_memory_t* b, int64_t ob, int64_t ldb,
+        blast_memory_t* c, int64_t oc, int64_t ldc,
+        int64_t m, int64_t n, int64_t k) {
+    blast_kernels(a->b, blast_fpp32);
+    blast_gemm_enqueue(a->b->gemm_mixed_k, sizeof(fp32_t),
+        a, oa, lda, b, ob, ldb, c, oc, ldc, m, n, k);
+}
+
+// Tuning file: header followed by blast_tuning_t.shape[][][]. Key is
+// FNV-1a 64 of device name and driver version, any mismatch (other
+// device, driver update, different layout) makes .init() ignore the file.
+
+typedef struct blast_tuning_header_s {
+    uint64_t magic; // blast_tuning_magic
+    uint64_t key;   // FNV-1a 64 of device name and driver version
+    uint64_t bytes; // sizeof(blast_tuning_t.shape)
+} blast_tuning_header_t;
+
+static const uint64_t blast_tuning_magic = 0x656E7554746C62ULL; // "bltTune"
+
+static uint64_t blast_tuning_key(const ocl_device_t* d) {
+    uint64_t h = 0xCBF29CE484222325ULL; // FNV offset basis
+    const char* s[] = { d->name, d->driver };
+    for (int i = 0; i < countof(s); i++) {
+        const uint8_t* p = (const uint8_t*)s[i];
+        for (size_t j = 0; j <= strlen(s[i]); j++) {
+            h ^= p[j];
+            h *= 0x100000001B3ULL; // FNV prime
+        }
+    }
+    return h;
+}
+
+static void blast_tuning_pathname(blast_t* b, char* pn, size_t count) {
+    const char* folder = ocl.cache.folder;
+    const ocl_device_t* d = &ocl.devices[b->c->ix];
+    if (folder == null || folder[0] == 0) { // disabled
+        pn[0] = 0;
+    } else {
+        snprintf(pn, count, "%s/blast_%016llX.tune", folder,
+                 (unsigned long long)blast_tuning_key(d));
+    }
+}
+
+static void blast_tuning_load(blast_t* b) {
+    memset(&b->tuning, 0, sizeof(b->tuning));
+    char* pn = b->tuning.pathname;
+    blast_tuning_pathname(b, pn, countof(b->tuning.pathname));
+    FILE* f = pn[0] != 0 ? fopen(pn, "rb") : null;
+    if (f != null) {
+        const ocl_device_t* d = &ocl.devices[b->c->ix];
+        blast_tuning_header_t h = {0};
+        blast_tuning_t t = {0};
+        if (fread(&h, sizeof(h), 1, f) == 1 &&
+            h.magic == blast_tuning_magic && h.key == blast_tuning_key(d) &&
+            h.bytes == sizeof(t.shape) &&
+            fread(t.shape, sizeof(t.shape), 1, f) == 1) {
+            const blast_shape_t* s = &t.shape[0][0][0];
+            for (int i = 0; i < (int)(sizeof(t.shape) / sizeof(*s)); i++) {
+                if (s[i].items > 0 || s[i].groups > 0) { t.loaded++; }
+            }
+            memcpy(b->tuning.shape, t.shape, sizeof(t.shape));
+            b->tuning.loaded = t.loaded;
+        }
+        fclose(f);
+    }
+}
+
+static void blast_tuning_save(blast_t* b) {
+    // written to a file unique to process and thread and renamed over
+    // the tuning file (see ocl_cache_store()): readers never see a torn file
+    const char* pn = b->tuning.pathname;
+    if (pn[0] != 0) {
+        char tmp[countof(b->tuning.pathname) + 32];
+        snprintf(tmp, countof(tmp), "%s.%08X.%08X.tmp", pn,
+                 process_id(), thread_id());
+        FILE* f = fopen(tmp, "wb");
+        if (f != null) { // failure to write tuning file is not fatal
+            blast_tuning_header_t h = {
+                .magic = blast_tuning_magic,
+                .key = blast_tuning_key(&ocl.devices[b->c->ix]),
+                .bytes = sizeof(b->tuning.shape)
+            };
+            bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+                fwrite(b->tuning.shape, sizeof(b->tuning.shape), 1, f) == 1;
+            ok = fclose(f) == 0 && ok;
+            if (!ok || !file_replace(tmp, pn)) { remove(tmp); }
+        }
+    }
+}
+
+// Auto-tuner: for every problem size bucket 2^k (1K and up) candidate
+// shapes (items: multiples of kernel preferred work-group multiple up to
+// kernel work-group limit and max_items[0], groups: 1..16 per compute
+// unit) are timed (best of 3 runs, device time from profiling events)
+// against planner defaults. Square-ish m x n matrices are used for gemv().
+
+enum { blast_tune_min_bucket = 10, blast_tune_runs = 3 };
+
+static double blast_tune_time(blast_t* b, int op, int fpp,
+        blast_memory_t* v0, blast_memory_t* v1, blast_memory_t* r,
+        int64_t bucket) {
+    const int64_t elements = 1LL << bucket;
+    double best = DBL_MAX;
+    for (int i = 0; i < blast_tune_runs; i++) {
+        if (op == blast_tune_dot) {
+            (void)b->dot[fpp](v0, 0, 1, v1, 0, 1, elements);
+        } else {
+            const int64_t n = 1LL << (bucket / 2);
+            b->gemv[fpp](v0, 0, n, v1, 0, 1, r, elements / n, n);
+        }
+        best = min(best, b->c->ov->profiling[0].time);
+    }
+    return best;
+}
+
+static void blast_tune_op(blast_t* b, int op, int fpp, int64_t buckets,
+        blast_memory_t* v0, blast_memory_t* v1, blast_memory_t* r) {
+    const ocl_device_t* d = &ocl.devices[b->c->ix];
+    ocl_kernel_t k = op == blast_tune_dot ?
+        b->dot_reduce[fpp] : b->gemv_tiled[fpp];
+    ocl_kernel_info_t info = {0};
+    ocl.kernel_info(b->c, k, &info);
+    const int64_t limit = min(info.work_group, d->max_items[0]);
+    const int64_t multiple = max(1, min(info.preferred_work_group_multiple,
+                                        limit));
+    for (int64_t bucket = blast_tune_min_bucket; bucket <= buckets; bucket++) {
+        blast_shape_t* s = &b->tuning.shape[op][fpp][bucket];
+        *s = (blast_shape_t){0};
+        blast_shape_t best = *s;
+        double time = blast_tune_time(b, op, fpp, v0, v1, r, bucket);
+        for (int64_t items = multiple; items <= limit; items *= 2) {
+            for (int32_t groups = 1; groups <= 16; groups *= 2) {
+                *s = (blast_shape_t){ .items = (int32_t)items, .groups = groups };
+                const double t = blast_tune_time(b, op, fpp, v0, v1, r, bucket);
+                if (t < time) { time = t; best = *s; }
+            }
+        }
+        *s = best;
+    }
+}
+
+static void blast_tune(blast_t* b, int64_t n) {
+    fatal_if(!ocl.is_profiling(b->c), "tune() requires profiling context");
+    const int64_t buckets = blast_tune_bucket(n);
+    fatal_if(buckets < blast_tune_min_bucket, "n: %lld too small", n);
+    const int64_t elements = 1LL << buckets;
+    const bool chain = b->chain;
+    b->chain = false; // only dot_reduce() path is tuned
+    for (int fp = blast_fpp16; fp <= blast_fpp64; fp++) {
+        if (b->dot[fp] == null) { continue; }
+        blast_kernels(b, fp);
+        const int64_t bytes = elements * blast_fpp_bytes[fp];
+        blast_memory_t v[3];
+        for (int i = 0; i < countof(v); i++) {
+            v[i] = blast.allocate(b, blast_access_rw, bytes);
+            memset(blast.map(&v[i], blast_access_write, 0, bytes), 0, bytes);
+            blast.unmap(&v[i]);
+        }
+        for (int op = blast_tune_dot; op < blast_tune_ops; op++) {
+            blast_tune_op(b, op, fp, buckets, &v[0], &v[1], &v[2]);
+        }
+        for (int i = 0; i < countof(v); i++) { blast.deallocate(&v[i]); }
+    }
+    b->chain = chain;
+    blast_tuning_save(b);
+}
+
 static const char* blast_program_options(blast_t* b, int fpp) {
     static const char* type_t[] = {"half", "float", "double"};
+    static const char* acc_t[]  = {"float", "float", "double"};
     static const char* suffix[] = {"fp16", "fp32", "fp64"};
     const char* fp_t = type_t[fpp];
     // see https://man.opencl.org/clBuildProgram.html
     const ocl_device_t* d = &ocl.devices[b->c->ix];
-    static char options[4096];
+    static thread_local char options[4096];
     char* p = options;
     #pragma push_macro("append")
     #define append(...) do {                                             \
@@ -289,6 +1468,7 @@ static const char* blast_program_options(blast_t* b, int fpp) {
     append("-D fp16_t=half -D fp32_t=float -D fp64_t=double ");
     append("-D int32_t=int -D int64_t=long ");
     append("-cl-std=CL%d.%d ", d->c_version_major, d->c_version_minor);
+    append("-D acc_t=%s -D blast_fpp=%d ", acc_t[fpp], fpp);
     append("-D fp_t=%s -D vec4=%s4 -D vec8=%s8 -D vec16=%s16 -D suffix=%s %s ",
            fp_t, fp_t,fp_t, fp_t, suffix[fpp],
           (fpp == blast_fpp16 ? "-D fp16_surrogate" : ""));
@@ -298,15 +1478,117 @@ static const char* blast_program_options(blast_t* b, int fpp) {
     return options;
 }
 
-static ocl_program_t blast_compile(blast_t* b, int fpp,
+static ocl_build_t blast_compile(blast_t* b, int fpp,
         const void* code, int bytes) {
 //  traceln("\nfpp: %s\n%*.*s\n\n", blast_fpp_names[fpp], bytes, bytes, code);
     const char* opts = blast_program_options(b, fpp);
-    return ocl.compile_program(b->c, code, bytes, opts);
+    return ocl.compile_program_async(b->c, code, bytes, opts);
+}
+
+// Programs for all precisions are built simultaneously on host threads
+// by blast_init(). Kernels of a program are created when the program is
+// first needed by an operation (blast_kernels() waits for the build).
+
+static void blast_kernels(blast_t* b, int fp) {
+    if (b->build[fp] == null) { return; } // already created (or no fp)
+    ocl_program_t p = ocl.program(b->build[fp]);
+    b->build[fp] = null;
+    static const char* sum_odd[]     = {"sum_odd_fp16",     "sum_odd_fp32",     "sum_odd_fp64"};
+    static const char* sum_odd_os[]  = {"sum_odd_os_fp16",  "sum_odd_os_fp32",  "sum_odd_os_fp64"};
+    static const char* sum_even[]    = {"sum_even_fp16",    "sum_even_fp32",    "sum_even_fp64"};
+    static const char* sum_even_os[] = {"sum_even_os_fp16", "sum_even_os_fp32", "sum_even_os_fp64"};
+    static const char* dot[]         = {"dot_fp16",         "dot_fp32",         "dot_fp64"};
+    static const char* dot_os[]      = {"dot_os_fp16",      "dot_os_fp32",      "dot_os_fp64"};
+    static const char* dot_reduce[]  = {"dot_reduce_fp16",  "dot_reduce_fp32",  "dot_reduce_fp64"};
+    static const char* dot_reduce_os[] = {"dot_reduce_os_fp16", "dot_reduce_os_fp32", "dot_reduce_os_fp64"};
+    static const char* sum_reduce[]  = {"sum_reduce_fp16",  "sum_reduce_fp32",  "sum_reduce_fp64"};
+    static const char* dot_batched[] = {"dot_batched_fp16", "dot_batched_fp32", "dot_batched_fp64"};
+    static const char* gemv[]        = {"gemv_fp16",        "gemv_fp32",        "gemv_fp64"};
+    static const char* gemv_os[]     = {"gemv_os_fp16",     "gemv_os_fp32",     "gemv_os_fp64"};
+    static const char* gemv_tiled[]  = {"gemv_tiled_fp16",  "gemv_tiled_fp32",  "gemv_tiled_fp64"};
+    static const char* copy[]        = {"copy_fp16",        "copy_fp32",        "copy_fp64"};
+    static const char* gemm[]        = {"gemm_fp16",        "gemm_fp32",        "gemm_fp64"};
+    b->sum_odd[fp]     = ocl.create_kernel(p, sum_odd[fp]);
+    b->sum_odd_os[fp]  = ocl.create_kernel(p, sum_odd_os[fp]);
+    b->sum_even[fp]    = ocl.create_kernel(p, sum_even[fp]);
+    b->sum_even_os[fp] = ocl.create_kernel(p, sum_even_os[fp]);
+    b->dot_c[fp]       = ocl.create_kernel(p, dot[fp]);
+    b->dot_os[fp]      = ocl.create_kernel(p, dot_os[fp]);
+    b->dot_reduce[fp]    = ocl.create_kernel(p, dot_reduce[fp]);
+    b->dot_reduce_os[fp] = ocl.create_kernel(p, dot_reduce_os[fp]);
+    b->sum_reduce[fp]    = ocl.create_kernel(p, sum_reduce[fp]);
+    b->dot_batched_k[fp] = ocl.create_kernel(p, dot_batched[fp]);
+    b->gemv_c[fp]      = ocl.create_kernel(p, gemv[fp]);
+    b->gemv_os[fp]     = ocl.create_kernel(p, gemv_os[fp]);
+    b->gemv_tiled[fp]  = ocl.create_kernel(p, gemv_tiled[fp]);
+    b->copy[fp]        = ocl.create_kernel(p, copy[fp]);
+    b->gemm_k[fp]      = ocl.create_kernel(p, gemm[fp]);
+    if (fp == blast_fpp32) {
+        b->gemv_mixed_k = ocl.create_kernel(p, "gemv_mixed");
+        b->gemv_q_k[blast_q8] = ocl.create_kernel(p, "gemv_q8");
+        b->gemv_q_k[blast_q4] = ocl.create_kernel(p, "gemv_q4");
+        b->gemm_mixed_k = ocl.create_kernel(p, "gemm_mixed");
+    }
+    ocl.release_program(p);
+    b->compiled[fp] = true;
+}
+
+// Clone owns private instances of the kernels, thus its operations do not
+// race on kernel arguments with operations of "from" on another thread.
+
+static void blast_clone_kernels(blast_t* b, int fp) {
+    #pragma push_macro("clone")
+    #define clone(k) do { k = ocl.clone_kernel(k); } while (0)
+    clone(b->sum_odd[fp]);
+    clone(b->sum_odd_os[fp]);
+    clone(b->sum_even[fp]);
+    clone(b->sum_even_os[fp]);
+    clone(b->dot_c[fp]);
+    clone(b->dot_os[fp]);
+    clone(b->dot_reduce[fp]);
+    clone(b->dot_reduce_os[fp]);
+    clone(b->sum_reduce[fp]);
+    clone(b->dot_batched_k[fp]);
+    clone(b->gemv_c[fp]);
+    clone(b->gemv_os[fp]);
+    clone(b->gemv_tiled[fp]);
+    clone(b->copy[fp]);
+    clone(b->gemm_k[fp]);
+    if (fp == blast_fpp32) {
+        clone(b->gemv_mixed_k);
+        clone(b->gemv_q_k[blast_q8]);
+        clone(b->gemv_q_k[blast_q4]);
+        clone(b->gemm_mixed_k);
+    }
+    #pragma pop_macro("clone")
+}
+
+static void blast_clone(blast_t* b, blast_t* from, ocl_context_t* c) {
+    for (int fp = blast_fpp16; fp <= blast_fpp64; fp++) {
+        blast_kernels(from, fp); // waits for pending builds
+    }
+    *b = *from; // operations, tuning and gemm_tile
+    b->c = c;
+    memset(&b->pool, 0, sizeof(b->pool));
+    for (int fp = blast_fpp16; fp <= blast_fpp64; fp++) {
+        if (b->compiled[fp]) { blast_clone_kernels(b, fp); }
+    }
+}
+
+static blast_memory_t blast_share(blast_memory_t* gm, blast_t* b) {
+    fatal_if(gm->b->c->c != b->c->c, "different OpenCL contexts");
+    blast_memory_t a = *gm;
+    a.b = b;
+    a.m = null;
+    return a;
 }
 
 static void blast_init(blast_t* b, ocl_context_t* c) {
     b->c = c;
+    memset(&b->pool, 0, sizeof(b->pool));
+    // gemm() default: 32 x 32 tile of c, 64 items of 4 x 4 micro-tiles
+    b->gemm_tile = (blast_gemm_tile_t){ .tile = 32, .items = 64 };
+    blast_tuning_load(b);
     ocl_device_t* d = &ocl.devices[b->c->ix];
     void* code = null;
     int64_t bytes64 = 0;
@@ -316,34 +1598,45 @@ static void blast_init(blast_t* b, ocl_context_t* c) {
     int bytes = (int)bytes64;
     const bool has_fp16 = (d->fp_config & ocl_fp16) != 0;
     const bool has_fp64 =  d->double_fp_config != 0;
-    ocl_program_t p[3] = {
-        has_fp16 ? blast_compile(b, blast_fpp16, code, bytes) : null,
-        blast_compile(b, blast_fpp32, code, bytes),
-        has_fp64 ? blast_compile(b, blast_fpp64, code, bytes) : null
-    };
-    static const char* sum_odd[]     = {"sum_odd_fp16",     "sum_odd_fp32",     "sum_odd_fp64"};
-    static const char* sum_odd_os[]  = {"sum_odd_os_fp16",  "sum_odd_os_fp32",  "sum_odd_os_fp64"};
-    static const char* sum_even[]    = {"sum_even_fp16",    "sum_even_fp32",    "sum_even_fp64"};
-    static const char* sum_even_os[] = {"sum_even_os_fp16", "sum_even_os_fp32", "sum_even_os_fp64"};
-    static const char* dot[]         = {"dot_fp16",         "dot_fp32",         "dot_fp64"};
-    static const char* dot_os[]      = {"dot_os_fp16",      "dot_os_fp32",      "dot_os_fp64"};
-    static const char* gemv[]        = {"gemv_fp16",        "gemv_fp32",        "gemv_fp64"};
-    static const char* gemv_os[]     = {"gemv_os_fp16",     "gemv_os_fp32",     "gemv_os_fp64"};
+    // resource memory stays mapped for the lifetime of the process
+    b->build[blast_fpp16] = has_fp16 ? blast_compile(b, blast_fpp16, code, bytes) : null;
+    b->build[blast_fpp32] = blast_compile(b, blast_fpp32, code, bytes);
+    b->build[blast_fpp64] = has_fp64 ? blast_compile(b, blast_fpp64, code, bytes) : null;
     for (int fp = blast_fpp16; fp <= blast_fpp64; fp++) {
-        if (p[fp] != null) {
-            b->sum_odd[fp]     = ocl.create_kernel(p[fp], sum_odd[fp]);
-            b->sum_odd_os[fp]  = ocl.create_kernel(p[fp], sum_odd_os[fp]);
-            b->sum_even[fp]    = ocl.create_kernel(p[fp], sum_even[fp]);
-            b->sum_even_os[fp] = ocl.create_kernel(p[fp], sum_even_os[fp]);
-            b->dot_c[fp]       = ocl.create_kernel(p[fp], dot[fp]);
-            b->dot_os[fp]      = ocl.create_kernel(p[fp], dot_os[fp]);
-            b->gemv_c[fp]      = ocl.create_kernel(p[fp], gemv[fp]);
-            b->gemv_os[fp]     = ocl.create_kernel(p[fp], gemv_os[fp]);
-            ocl.release_program(p[fp]);
+        b->compiled[fp] = false;
+        if (b->build[fp] != null) {
             switch (fp) {
-                case blast_fpp16: b->dot[fp] = blast_dot_fp16; break;
-                case blast_fpp32: b->dot[fp] = blast_dot_fp32; break;
-                case blast_fpp64: b->dot[fp] = blast_dot_fp64; break;
+                case blast_fpp16:
+                    b->dot[fp] = blast_dot_fp16;
+                    b->dot_async[fp] = blast_dot_async_fp16;
+                    b->dot_batched[fp] = blast_dot_batched_fp16;
+                    b->gemv[fp] = blast_gemv_fp16;
+                    b->gemv_async[fp] = blast_gemv_async_fp16;
+                    b->gemm[fp] = blast_gemm_fp16;
+                    break;
+                case blast_fpp32:
+                    b->dot[fp] = blast_dot_fp32;
+                    b->dot_async[fp] = blast_dot_async_fp32;
+                    b->dot_batched[fp] = blast_dot_batched_fp32;
+                    b->gemv[fp] = blast_gemv_fp32;
+                    b->gemv_async[fp] = blast_gemv_async_fp32;
+                    b->gemm[fp] = blast_gemm_fp32;
+                    b->gemv_mixed = blast_gemv_mixed;
+                    b->gemv_mixed_async = blast_gemv_mixed_async;
+                    b->gemv_q[blast_q8] = blast_gemv_q8;
+                    b->gemv_q[blast_q4] = blast_gemv_q4;
+                    b->gemv_q_async[blast_q8] = blast_gemv_q8_async;
+                    b->gemv_q_async[blast_q4] = blast_gemv_q4_async;
+                    b->gemm_mixed = blast_gemm_mixed;
+                    break;
+                case blast_fpp64:
+                    b->dot[fp] = blast_dot_fp64;
+                    b->dot_async[fp] = blast_dot_async_fp64;
+                    b->dot_batched[fp] = blast_dot_batched_fp64;
+                    b->gemv[fp] = blast_gemv_fp64;
+                    b->gemv_async[fp] = blast_gemv_async_fp64;
+                    b->gemm[fp] = blast_gemm_fp64;
+                    break;
                 default: fatal_if("never");
             }
         }
@@ -351,28 +1644,224 @@ static void blast_init(blast_t* b, ocl_context_t* c) {
 }
 
 static void blast_fini(blast_t* b) {
-    ocl_device_t* d = &ocl.devices[b->c->ix];
-    // all known GPU support at least fp32_t but many do not support
-    // fp16_t and/or fp64_t
-    int from = (d->fp_config & ocl_fp16) != 0 ? blast_fpp16 : blast_fpp32;
-    int to   =  d->double_fp_config != 0 ? blast_fpp64 : blast_fpp32;
-    for (int fp = from; fp <= to; fp++) {
-        ocl.release_kernel(b->sum_odd[fp]);
-        ocl.release_kernel(b->sum_odd_os[fp]);
-        ocl.release_kernel(b->sum_even[fp]);
-        ocl.release_kernel(b->sum_even_os[fp]);
-        ocl.release_kernel(b->dot_c[fp]);
-        ocl.release_kernel(b->dot_os[fp]);
-        ocl.release_kernel(b->gemv_c[fp]);
-        ocl.release_kernel(b->gemv_os[fp]);
+    for (int fp = blast_fpp16; fp <= blast_fpp64; fp++) {
+        if (b->build[fp] != null) { // never used, wait for the build
+            ocl.release_program(ocl.program(b->build[fp]));
+            b->build[fp] = null;
+        } else if (b->compiled[fp]) {
+            ocl.release_kernel(b->sum_odd[fp]);
+            ocl.release_kernel(b->sum_odd_os[fp]);
+            ocl.release_kernel(b->sum_even[fp]);
+            ocl.release_kernel(b->sum_even_os[fp]);
+            ocl.release_kernel(b->dot_c[fp]);
+            ocl.release_kernel(b->dot_os[fp]);
+            ocl.release_kernel(b->dot_reduce[fp]);
+            ocl.release_kernel(b->dot_reduce_os[fp]);
+            ocl.release_kernel(b->sum_reduce[fp]);
+            ocl.release_kernel(b->dot_batched_k[fp]);
+            ocl.release_kernel(b->gemv_c[fp]);
+            ocl.release_kernel(b->gemv_os[fp]);
+            ocl.release_kernel(b->gemv_tiled[fp]);
+            ocl.release_kernel(b->copy[fp]);
+            ocl.release_kernel(b->gemm_k[fp]);
+            if (fp == blast_fpp32) {
+                ocl.release_kernel(b->gemv_mixed_k);
+                ocl.release_kernel(b->gemv_q_k[blast_q8]);
+                ocl.release_kernel(b->gemv_q_k[blast_q4]);
+                ocl.release_kernel(b->gemm_mixed_k);
+            }
+            b->compiled[fp] = false;
+        }
     }
+    blast_trim(b, 0);
 }
 
 blast_if blast = {
     .init       = blast_init,
+    .clone      = blast_clone,
     .allocate   = blast_allocate,
+    .wrap       = blast_wrap,
+    .allocate_svm = blast_allocate_svm,
+    .view       = blast_view,
+    .share      = blast_share,
     .deallocate = blast_deallocate,
     .map        = blast_map,
     .unmap      = blast_unmap,
-    .fini       = blast_fini
+    .scratch    = blast_scratch,
+    .release    = blast_release,
+    .trim       = blast_trim,
+    .tune       = blast_tune,
+    .ready      = blast_ready,
+    .wait       = blast_wait,
+    .fini       = blast_fini,
+    .quantized_bytes  = blast_quantized_bytes,
+    .quantize         = blast_quantize,
+    .dequantize       = blast_dequantize,
+    .gemv_q_reference = blast_gemv_q_reference
+};
+
+// Multi-device blast (see blast_multi_t)
+
+static void blast_multi_split(blast_multi_t* mb, int64_t rows,
+        int64_t from[blast_max_devices + 1]) {
+    double cumulative = 0;
+    from[0] = 0;
+    for (int i = 0; i < mb->count; i++) {
+        cumulative += mb->share[i];
+        from[i + 1] = min(rows, (int64_t)(rows * cumulative + 0.5));
+    }
+    from[mb->count] = rows; // rounding
+}
+
+static void blast_multi_open(blast_multi_t* mb, int32_t count,
+        const int32_t devices[]) {
+    fatal_if(count < 1 || count > blast_max_devices, "count: %d", count);
+    memset(mb, 0, sizeof(*mb));
+    mb->count = count;
+    for (int i = 0; i < count; i++) {
+        mb->c[i] = ocl.open(devices[i], null);
+        blast.init(&mb->b[i], &mb->c[i]);
+        mb->share[i] = 1.0 / count;
+    }
+}
+
+static void blast_multi_close(blast_multi_t* mb) {
+    for (int i = 0; i < mb->count; i++) {
+        blast.fini(&mb->b[i]);
+        ocl.close(&mb->c[i]);
+    }
+    memset(mb, 0, sizeof(*mb));
+}
+
+static void blast_multi_calibrate(blast_multi_t* mb) {
+    // host time of fp32 gemv() (memory bound like dot()) on each device
+    enum { m = 1024, n = 1024, runs = 4 };
+    double throughput[blast_max_devices] = {0};
+    double sum = 0;
+    for (int i = 0; i < mb->count; i++) {
+        blast_t* b = &mb->b[i];
+        const int64_t bytes = m * n * sizeof(fp32_t);
+        blast_memory_t mx = blast.allocate(b, blast_access_write, bytes);
+        blast_memory_t v  = blast.allocate(b, blast_access_write, n * sizeof(fp32_t));
+        blast_memory_t r  = blast.allocate(b, blast_access_read,  m * sizeof(fp32_t));
+        memset(blast.map(&mx, blast_access_write, 0, bytes), 0, bytes);
+        blast.unmap(&mx);
+        memset(blast.map(&v, blast_access_write, 0, n * sizeof(fp32_t)), 0,
+               n * sizeof(fp32_t));
+        blast.unmap(&v);
+        b->gemv[blast_fpp32](&mx, 0, n, &v, 0, 1, &r, m, n); // warm up
+        double time = seconds();
+        for (int k = 0; k < runs; k++) {
+            b->gemv[blast_fpp32](&mx, 0, n, &v, 0, 1, &r, m, n);
+        }
+        time = seconds() - time;
+        throughput[i] = (double)runs * m * n / max(time, 1e-9);
+        sum += throughput[i];
+        blast.deallocate(&r);
+        blast.deallocate(&v);
+        blast.deallocate(&mx);
+    }
+    for (int i = 0; i < mb->count; i++) { mb->share[i] = throughput[i] / sum; }
+}
+
+static blast_sharded_t blast_multi_shard(blast_multi_t* mb, int fpp,
+        const void* data, int64_t rows, int64_t columns) {
+    fatal_if(fpp < blast_fpp16 || blast_fpp64 < fpp, "fpp: %d", fpp);
+    fatal_if(rows <= 0 || columns <= 0, "rows: %lld columns: %lld",
+             rows, columns);
+    blast_sharded_t s = { .mb = mb, .fpp = fpp, .rows = rows,
+                          .columns = columns };
+    blast_multi_split(mb, rows, s.from);
+    const int64_t row_bytes = columns * blast_fpp_bytes[fpp];
+    for (int i = 0; i < mb->count; i++) { // fp16 and fp64 are optional
+        const blast_t* b = &mb->b[i];
+        fatal_if(b->dot_async[fpp] == null || b->gemv_async[fpp] == null,
+                 "%s does not support fpp: %d", ocl.devices[b->c->ix].name,
+                 fpp);
+    }
+    for (int i = 0; i < mb->count; i++) {
+        const int64_t bytes = (s.from[i + 1] - s.from[i]) * row_bytes;
+        if (bytes > 0) {
+            s.m[i] = blast.allocate(&mb->b[i], blast_access_read, bytes);
+            void* a = blast.map(&s.m[i], blast_access_write, 0, bytes);
+            memcpy(a, (const byte_t*)data + s.from[i] * row_bytes, bytes);
+            blast.unmap(&s.m[i]);
+        }
+    }
+    return s;
+}
+
+static void blast_multi_unshard(blast_sharded_t* s) {
+    for (int i = 0; i < s->mb->count; i++) {
+        if (s->m[i].h != null) { blast.deallocate(&s->m[i]); }
+    }
+    memset(s, 0, sizeof(*s));
+}
+
+static fp64_t blast_multi_dot(blast_sharded_t* v0, blast_sharded_t* v1) {
+    blast_multi_t* mb = v0->mb;
+    fatal_if(v1->mb != mb || v0->fpp != v1->fpp || v0->rows != v1->rows ||
+             v0->columns != 1 || v1->columns != 1 ||
+             memcmp(v0->from, v1->from, sizeof(v0->from)) != 0,
+             "vectors must be sharded identically");
+    blast_future_t f[blast_max_devices] = {0};
+    for (int i = 0; i < mb->count; i++) {
+        const int64_t n = v0->from[i + 1] - v0->from[i];
+        if (n > 0) {
+            f[i] = mb->b[i].dot_async[v0->fpp](&v0->m[i], 0, 1,
+                &v1->m[i], 0, 1, n, null);
+            ocl.flush(&mb->c[i]); // start before waiting for other devices
+        }
+    }
+    fp64_t s = 0;
+    for (int i = 0; i < mb->count; i++) {
+        if (v0->from[i + 1] > v0->from[i]) { s += blast.wait(&f[i]); }
+    }
+    return s;
+}
+
+static void blast_multi_gemv(blast_sharded_t* mx, const void* v, void* r) {
+    blast_multi_t* mb = mx->mb;
+    const int fpp = mx->fpp;
+    const int64_t n = mx->columns;
+    const int64_t bytes = blast_fpp_bytes[fpp];
+    blast_memory_t vi[blast_max_devices] = {0};
+    blast_memory_t ri[blast_max_devices] = {0};
+    blast_future_t f[blast_max_devices] = {0};
+    for (int i = 0; i < mb->count; i++) {
+        const int64_t m = mx->from[i + 1] - mx->from[i];
+        if (m > 0) {
+            blast_t* b = &mb->b[i];
+            vi[i] = blast.scratch(b, n * bytes);
+            memcpy(blast.map(&vi[i], blast_access_write, 0, n * bytes), v,
+                   n * bytes);
+            blast.unmap(&vi[i]);
+            ri[i] = blast.scratch(b, m * bytes);
+            f[i] = b->gemv_async[fpp](&mx->m[i], 0, n, &vi[i], 0, 1,
+                &ri[i], m, n, null);
+            ocl.flush(&mb->c[i]);
+        }
+    }
+    for (int i = 0; i < mb->count; i++) {
+        const int64_t m = mx->from[i + 1] - mx->from[i];
+        if (m > 0) {
+            blast.wait(&f[i]);
+            memcpy((byte_t*)r + mx->from[i] * bytes,
+                   blast.map(&ri[i], blast_access_read, 0, m * bytes),
+                   m * bytes);
+            blast.unmap(&ri[i]);
+            blast.release(&ri[i]);
+            blast.release(&vi[i]);
+        }
+    }
+}
+
+blast_multi_if blast_multi = {
+    .open      = blast_multi_open,
+    .calibrate = blast_multi_calibrate,
+    .shard     = blast_multi_shard,
+    .unshard   = blast_multi_unshard,
+    .dot       = blast_multi_dot,
+    .gemv      = blast_multi_gemv,
+    .close     = blast_multi_close
 };
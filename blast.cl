@@ -4,6 +4,10 @@
 // or
 // #define fp_t double
 // #define fp_t half
+// and accumulator type for reductions (float for half, fp_t otherwise)
+// #define acc_t float
+// and precision index (0: fp16, 1: fp32, 2: fp64 see blast.h blast_fpp*)
+// #define blast_fpp 1
 
 // for gemv() optimizations vec4, vec8, vec16 must be defined as:
 // #define vec4 type4
@@ -114,6 +118,95 @@ __kernel void name(dot_os, suffix)(
     r[i] = v0[offset0 + i * stride0] * v1[offset1 + i * stride1];
 }
 
+// Single pass alternative to the chain of sum_odd/sum_even above:
+// each work-item accumulates elements i, i + global_size, i + 2 * global_size
+// ... in registers (grid-stride loop), then work-group reduces these sums
+// in local memory to a single partial sum r[group]. Nothing of size "n"
+// is ever written. One work-group of sum_reduce() finishes partials into r[0].
+// Partial sums are accumulated in acc_t (float for half, fp_t otherwise).
+// Local size does not have to be a power of 2.
+
+#define acc_ro_t __global const acc_t* // read only accumulators
+#define acc_wr_t __global acc_t*       // write only accumulators
+
+inline acc_t reduce_local(__local acc_t* s, const acc_t v) {
+    const int32_t i = get_local_id(0);
+    int32_t n = get_local_size(0);
+    s[i] = v;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    while (n > 1) {
+        const int32_t h = (n + 1) / 2; // upper half [h..n - 1] folds down
+        if (i < n - h) { s[i] += s[i + h]; }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        n = h;
+    }
+    const acc_t sum = s[0];
+    barrier(CLK_LOCAL_MEM_FENCE); // s[] can be reused right after return
+    return sum;
+}
+
+__kernel void name(dot_reduce, suffix)(fp_ro_t const v0, fp_ro_t const v1,
+        acc_wr_t r, __local acc_t* s, const int32_t n) {
+    const int32_t stride = get_global_size(0);
+    acc_t sum = 0;
+    for (int32_t i = get_global_id(0); i < n; i += stride) {
+        sum += (acc_t)v0[i] * (acc_t)v1[i];
+    }
+    sum = reduce_local(s, sum);
+    if (get_local_id(0) == 0) { r[get_group_id(0)] = sum; }
+}
+
+__kernel void name(dot_reduce_os, suffix)(
+        fp_ro_t const v0, const int32_t offset0, const int32_t stride0,
+        fp_ro_t const v1, const int32_t offset1, const int32_t stride1,
+        acc_wr_t r, __local acc_t* s, const int32_t n) {
+    const int32_t stride = get_global_size(0);
+    acc_t sum = 0;
+    for (int32_t i = get_global_id(0); i < n; i += stride) {
+        sum += (acc_t)v0[offset0 + i * stride0] *
+               (acc_t)v1[offset1 + i * stride1];
+    }
+    sum = reduce_local(s, sum);
+    if (get_local_id(0) == 0) { r[get_group_id(0)] = sum; }
+}
+
+// must be enqueued as a single work-group: groups = 1
+__kernel void name(sum_reduce, suffix)(acc_ro_t const v, acc_wr_t r,
+        __local acc_t* s, const int32_t n) {
+    acc_t sum = 0;
+    for (int32_t i = get_local_id(0); i < n; i += get_local_size(0)) {
+        sum += v[i];
+    }
+    sum = reduce_local(s, sum);
+    if (get_local_id(0) == 0) { r[0] = sum; }
+}
+
+// Batched dot: r[offset + k] = dot(v0 + k * batch0, v1 + k * batch1) for
+// k in [0..count - 1] with "n" elements each. Each work-group reduces one
+// pair at a time and strides over pairs by the number of groups.
+// batch0 == 0 broadcasts the same v0 (e.g. query) against many v1 (keys).
+
+__kernel void name(dot_batched, suffix)(
+        fp_ro_t const v0, const int32_t offset0, const int32_t stride0,
+        const int32_t batch0,
+        fp_ro_t const v1, const int32_t offset1, const int32_t stride1,
+        const int32_t batch1,
+        fp_wr_t r, const int32_t offset, __local acc_t* s,
+        const int32_t n, const int32_t count) {
+    const int32_t li = get_local_id(0);
+    const int32_t ls = get_local_size(0);
+    for (int32_t k = get_group_id(0); k < count; k += get_num_groups(0)) {
+        fp_ro_t const a = v0 + offset0 + k * batch0;
+        fp_ro_t const b = v1 + offset1 + k * batch1;
+        acc_t sum = 0;
+        for (int32_t i = li; i < n; i += ls) {
+            sum += (acc_t)a[i * stride0] * (acc_t)b[i * stride1];
+        }
+        sum = reduce_local(s, sum);
+        if (li == 0) { r[offset + k] = (fp_t)sum; }
+    }
+}
+
 // TODO: dot16_fp16(), dot4_fp32(), dot4_fp4() future optimization
 
 // gemv General Matrix Multiplication by Vector
@@ -187,18 +280,358 @@ __kernel void name(gemv_os, suffix)(
     fp_ro_t v = vc + offset;
     fp_t s = 0;
     for (int32_t j = 0; j < n; j++) {
-        s += v[j * stride] * mx[j * column_stride];
+        s += v[j * stride] * m[j * column_stride];
     }
     r[i] = s;
 }
 
+// memory bandwidth reference for performance measurements
+__kernel void name(copy, suffix)(fp_ro_t const v, fp_wr_t r, const int32_t n) {
+    const int32_t stride = get_global_size(0);
+    for (int32_t i = get_global_id(0); i < n; i += stride) { r[i] = v[i]; }
+}
+
+// Tiled gemv: r[i] = dot(mx[offset + i * row_stride ...], v[...]) i: [0..m-1]
+// Each work-group computes gemv_rows rows at a time and strides over blocks
+// of rows. Vector is loaded cooperatively into local memory vt[tile] in
+// tiles (if n <= tile it is loaded only once per work-group) and is
+// reused for all rows. Each work-item reads 4 adjacent matrix elements
+// (vectorized and coalesced across work-items) and in-group reduction
+// finishes gemv_rows sums in local memory s[local_size].
+// "tile" must be a multiple of 4. stride is vector elements stride.
+
+#define gemv_rows 4
+
+#ifdef fp16_surrogate // half4 arithmetic may not be available
+#define load4(p) vload_half4(0, p) // float4 == acc_t4
+#else
+#define load4(p) vload4(0, p)
+#endif
+
+__kernel void name(gemv_tiled, suffix)(
+        fp_ro_t const mx, const int32_t mx_offset, const int32_t row_stride,
+        fp_ro_t const v, const int32_t offset, const int32_t stride,
+        fp_wr_t r, const int32_t m, const int32_t n,
+        __local acc_t* vt, const int32_t tile, __local acc_t* s) {
+    const int32_t li = get_local_id(0);
+    const int32_t ls = get_local_size(0);
+    const int32_t blocks = (m + gemv_rows - 1) / gemv_rows;
+    bool loaded = false;
+    for (int32_t b = get_group_id(0); b < blocks; b += get_num_groups(0)) {
+        const int32_t row = b * gemv_rows;
+        acc_t sum[gemv_rows];
+        for (int32_t k = 0; k < gemv_rows; k++) { sum[k] = 0; }
+        for (int32_t t = 0; t < n; t += tile) {
+            const int32_t e = min(tile, n - t); // elements in this tile
+            if (!loaded) {
+                for (int32_t j = li; j < e; j += ls) {
+                    vt[j] = (acc_t)v[offset + (t + j) * stride];
+                }
+                barrier(CLK_LOCAL_MEM_FENCE);
+                loaded = tile >= n; // single tile stays for all blocks
+            }
+            for (int32_t j = li * 4; j < e; j += ls * 4) {
+                for (int32_t k = 0; k < gemv_rows; k++) {
+                    if (row + k < m) {
+                        fp_ro_t const p = mx + mx_offset +
+                            (row + k) * row_stride + t + j;
+                        if (j + 4 <= e) {
+                            sum[k] += dot(load4(p), vload4(0, vt + j));
+                        } else {
+                            for (int32_t i = 0; i < e - j; i++) {
+                                sum[k] += (acc_t)p[i] * vt[j + i];
+                            }
+                        }
+                    }
+                }
+            }
+            if (!loaded) { barrier(CLK_LOCAL_MEM_FENCE); } // vt[] reloaded
+        }
+        for (int32_t k = 0; k < gemv_rows; k++) {
+            const acc_t rs = reduce_local(s, sum[k]);
+            if (li == 0 && row + k < m) { r[row + k] = (fp_t)rs; }
+        }
+    }
+}
+
+// Tiled gemm: c[m][n] = a[m][k] * b[k][n] (row major, offsets and leading
+// dimensions lda, ldb, ldc in elements).
+// 2D NDRange: work-group computes ts x ts tile of c at tile column
+// get_group_id(0) and tile row get_group_id(1) (host enqueues exactly one
+// group per tile). Tiles of a and b are loaded cooperatively into local
+// memory (zero padded at the edges). Each work-item owns wm x wn
+// micro-tile of c: for every kk it reads wm values of a and wn values of
+// b into private af[] and bf[] and does wm * wn multiply-adds, thus each
+// value read from local memory is reused wn (a) or wm (b) times.
+// Loops are bounded by compile time gemm_mr x gemm_nr (unrolled, arrays
+// stay in registers), lanes beyond wm x wn multiply zeros.
+// ts, wm, wn and ls == ceil(ts / wn) * ceil(ts / wm) are chosen by host
+// (see blast_gemm_plan() and blast_t.gemm_tile).
+
+#define gemm_mr 4 // must match blast_gemm_mr in blast.c
+#define gemm_nr 4 // must match blast_gemm_nr in blast.c
+
+inline void gemm_mac(__local const acc_t* as, __local const acc_t* bs,
+        const int32_t ts, const int32_t r0, const int32_t c0,
+        const int32_t wm, const int32_t wn, acc_t acc[gemm_mr][gemm_nr]) {
+    for (int32_t kk = 0; kk < ts; kk++) {
+        acc_t af[gemm_mr];
+        acc_t bf[gemm_nr];
+        for (int32_t i = 0; i < gemm_mr; i++) {
+            af[i] = i < wm && r0 + i < ts ? as[(r0 + i) * ts + kk] : 0;
+        }
+        for (int32_t j = 0; j < gemm_nr; j++) {
+            bf[j] = j < wn && c0 + j < ts ? bs[kk * ts + c0 + j] : 0;
+        }
+        for (int32_t i = 0; i < gemm_mr; i++) {
+            for (int32_t j = 0; j < gemm_nr; j++) {
+                acc[i][j] += af[i] * bf[j];
+            }
+        }
+    }
+}
+
+__kernel void name(gemm, suffix)(
+        fp_ro_t const a, const int32_t oa, const int32_t lda,
+        fp_ro_t const b, const int32_t ob, const int32_t ldb,
+        fp_wr_t c, const int32_t oc, const int32_t ldc,
+        const int32_t m, const int32_t n, const int32_t k,
+        __local acc_t* as, __local acc_t* bs, const int32_t ts,
+        const int32_t wm, const int32_t wn) {
+    const int32_t li = get_local_id(0);
+    const int32_t ls = get_local_size(0);
+    const int32_t gx = (ts + wn - 1) / wn; // micro-tiles in a tile row
+    const int32_t r0 = li / gx * wm; // micro-tile origin inside the tile
+    const int32_t c0 = li % gx * wn;
+    const int32_t row = get_group_id(1) * ts;
+    const int32_t col = get_group_id(0) * ts;
+    acc_t acc[gemm_mr][gemm_nr];
+    for (int32_t i = 0; i < gemm_mr; i++) {
+        for (int32_t j = 0; j < gemm_nr; j++) { acc[i][j] = 0; }
+    }
+    for (int32_t k0 = 0; k0 < k; k0 += ts) {
+        for (int32_t e = li; e < ts * ts; e += ls) {
+            const int32_t i = e / ts;
+            const int32_t j = e % ts;
+            as[e] = row + i < m && k0 + j < k ?
+                (acc_t)a[oa + (row + i) * lda + k0 + j] : 0;
+            bs[e] = k0 + i < k && col + j < n ?
+                (acc_t)b[ob + (k0 + i) * ldb + col + j] : 0;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        gemm_mac(as, bs, ts, r0, c0, wm, wn, acc);
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    for (int32_t i = 0; i < gemm_mr; i++) {
+        for (int32_t j = 0; j < gemm_nr; j++) {
+            const int32_t ci = row + r0 + i;
+            const int32_t cj = col + c0 + j;
+            if (i < wm && j < wn && r0 + i < ts && c0 + j < ts &&
+                ci < m && cj < n) {
+                c[oc + ci * ldc + cj] = (fp_t)acc[i][j];
+            }
+        }
+    }
+}
+
+#if blast_fpp == 1 // only in fp32 program
+
+// Mixed precision tiled gemv: fp16 matrix (vload_half4 does not require
+// cl_khr_fp16), vector fp16 (vfpp == 0) or fp32 (vfpp == 1), fp32
+// accumulation and result stored as fp16 (rfpp == 0) or fp32 (rfpp == 1).
+// Same tiling as gemv_tiled() above. vfpp and rfpp branches are uniform
+// and outside of the inner loop.
+
+__kernel void gemv_mixed(
+        __global const half* const mx,
+        const int32_t mx_offset, const int32_t row_stride,
+        __global const void* const v,
+        const int32_t offset, const int32_t stride, const int32_t vfpp,
+        __global void* r, const int32_t rfpp,
+        const int32_t m, const int32_t n,
+        __local float* vt, const int32_t tile, __local float* s) {
+    const int32_t li = get_local_id(0);
+    const int32_t ls = get_local_size(0);
+    const int32_t blocks = (m + gemv_rows - 1) / gemv_rows;
+    __global const half*  const vh = (__global const half*)v;
+    __global const float* const vf = (__global const float*)v;
+    bool loaded = false;
+    for (int32_t b = get_group_id(0); b < blocks; b += get_num_groups(0)) {
+        const int32_t row = b * gemv_rows;
+        float sum[gemv_rows];
+        for (int32_t k = 0; k < gemv_rows; k++) { sum[k] = 0; }
+        for (int32_t t = 0; t < n; t += tile) {
+            const int32_t e = min(tile, n - t); // elements in this tile
+            if (!loaded) {
+                for (int32_t j = li; j < e; j += ls) {
+                    const int32_t i = offset + (t + j) * stride;
+                    vt[j] = vfpp == 0 ? vload_half(i, vh) : vf[i];
+                }
+                barrier(CLK_LOCAL_MEM_FENCE);
+                loaded = tile >= n; // single tile stays for all blocks
+            }
+            for (int32_t j = li * 4; j < e; j += ls * 4) {
+                for (int32_t k = 0; k < gemv_rows; k++) {
+                    if (row + k < m) {
+                        __global const half* const p = mx + mx_offset +
+                            (row + k) * row_stride + t + j;
+                        if (j + 4 <= e) {
+                            sum[k] += dot(vload_half4(0, p), vload4(0, vt + j));
+                        } else {
+                            for (int32_t i = 0; i < e - j; i++) {
+                                sum[k] += vload_half(i, p) * vt[j + i];
+                            }
+                        }
+                    }
+                }
+            }
+            if (!loaded) { barrier(CLK_LOCAL_MEM_FENCE); } // vt[] reloaded
+        }
+        for (int32_t k = 0; k < gemv_rows; k++) {
+            const float rs = reduce_local(s, sum[k]);
+            if (li == 0 && row + k < m) {
+                if (rfpp == 0) {
+                    vstore_half(rs, row + k, (__global half*)r);
+                } else {
+                    ((__global float*)r)[row + k] = rs;
+                }
+            }
+        }
+    }
+}
+
+// Block quantized gemv (see blast.h blast_q8, blast_q4 for the layout).
+// Values are dequantized in registers: 4 adjacent quants never cross a
+// block boundary because n % 32 == 0 and tiles are multiples of 4.
+// bits is a compile time constant after inlining into kernels below.
+
+#define q_block 32
+
+inline float4 dequantize4(__global const uchar* q, const int32_t bits,
+        const int32_t i) { // i % 4 == 0
+    if (bits == 8) {
+        return convert_float4(vload4(0, (__global const char*)q + i));
+    } else {
+        const uchar2 b = vload2(0, q + i / 2);
+        const int4 nibbles = (int4)(b.x & 0xF, b.x >> 4, b.y & 0xF, b.y >> 4);
+        return convert_float4(nibbles - 8);
+    }
+}
+
+inline void gemv_q(const int32_t bits,
+        __global const uchar* const q, const int32_t m, const int32_t n,
+        __global const float* const v, const int32_t offset,
+        const int32_t stride, __global float* r,
+        __local float* vt, const int32_t tile, __local float* s) {
+    const int32_t li = get_local_id(0);
+    const int32_t ls = get_local_size(0);
+    const int32_t blocks = (m + gemv_rows - 1) / gemv_rows;
+    const int32_t quant_bytes = bits == 8 ? m * n : m * n / 2;
+    __global const half* const scales = (__global const half*)(q + quant_bytes);
+    bool loaded = false;
+    for (int32_t b = get_group_id(0); b < blocks; b += get_num_groups(0)) {
+        const int32_t row = b * gemv_rows;
+        float sum[gemv_rows];
+        for (int32_t k = 0; k < gemv_rows; k++) { sum[k] = 0; }
+        for (int32_t t = 0; t < n; t += tile) {
+            const int32_t e = min(tile, n - t); // elements in this tile
+            if (!loaded) {
+                for (int32_t j = li; j < e; j += ls) {
+                    vt[j] = v[offset + (t + j) * stride];
+                }
+                barrier(CLK_LOCAL_MEM_FENCE);
+                loaded = tile >= n; // single tile stays for all blocks
+            }
+            for (int32_t j = li * 4; j < e; j += ls * 4) {
+                for (int32_t k = 0; k < gemv_rows; k++) {
+                    if (row + k < m) {
+                        const int32_t i = (row + k) * n + t + j;
+                        const float scale = vload_half(i / q_block, scales);
+                        sum[k] += scale * dot(dequantize4(q, bits, i),
+                                              vload4(0, vt + j));
+                    }
+                }
+            }
+            if (!loaded) { barrier(CLK_LOCAL_MEM_FENCE); } // vt[] reloaded
+        }
+        for (int32_t k = 0; k < gemv_rows; k++) {
+            const float rs = reduce_local(s, sum[k]);
+            if (li == 0 && row + k < m) { r[row + k] = rs; }
+        }
+    }
+}
+
+__kernel void gemv_q8(__global const uchar* const q,
+        const int32_t m, const int32_t n,
+        __global const float* const v, const int32_t offset,
+        const int32_t stride, __global float* r,
+        __local float* vt, const int32_t tile, __local float* s) {
+    gemv_q(8, q, m, n, v, offset, stride, r, vt, tile, s);
+}
+
+__kernel void gemv_q4(__global const uchar* const q,
+        const int32_t m, const int32_t n,
+        __global const float* const v, const int32_t offset,
+        const int32_t stride, __global float* r,
+        __local float* vt, const int32_t tile, __local float* s) {
+    gemv_q(4, q, m, n, v, offset, stride, r, vt, tile, s);
+}
+
+// Mixed precision gemm: fp16 a and b (vload_half), fp32 accumulation
+// and fp32 c. Same tiling as gemm() above.
+
+__kernel void gemm_mixed(
+        __global const half* const a, const int32_t oa, const int32_t lda,
+        __global const half* const b, const int32_t ob, const int32_t ldb,
+        __global float* c, const int32_t oc, const int32_t ldc,
+        const int32_t m, const int32_t n, const int32_t k,
+        __local float* as, __local float* bs, const int32_t ts,
+        const int32_t wm, const int32_t wn) {
+    const int32_t li = get_local_id(0);
+    const int32_t ls = get_local_size(0);
+    const int32_t gx = (ts + wn - 1) / wn; // micro-tiles in a tile row
+    const int32_t r0 = li / gx * wm; // micro-tile origin inside the tile
+    const int32_t c0 = li % gx * wn;
+    const int32_t row = get_group_id(1) * ts;
+    const int32_t col = get_group_id(0) * ts;
+    float acc[gemm_mr][gemm_nr];
+    for (int32_t i = 0; i < gemm_mr; i++) {
+        for (int32_t j = 0; j < gemm_nr; j++) { acc[i][j] = 0; }
+    }
+    for (int32_t k0 = 0; k0 < k; k0 += ts) {
+        for (int32_t e = li; e < ts * ts; e += ls) {
+            const int32_t i = e / ts;
+            const int32_t j = e % ts;
+            as[e] = row + i < m && k0 + j < k ?
+                vload_half(oa + (row + i) * lda + k0 + j, a) : 0;
+            bs[e] = k0 + i < k && col + j < n ?
+                vload_half(ob + (k0 + i) * ldb + col + j, b) : 0;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        gemm_mac(as, bs, ts, r0, c0, wm, wn, acc);
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    for (int32_t i = 0; i < gemm_mr; i++) {
+        for (int32_t j = 0; j < gemm_nr; j++) {
+            const int32_t ci = row + r0 + i;
+            const int32_t cj = col + c0 + j;
+            if (i < wm && j < wn && r0 + i < ts && c0 + j < ts &&
+                ci < m && cj < n) {
+                c[oc + ci * ldc + cj] = acc[i][j];
+            }
+        }
+    }
+}
+
+#endif // blast_fpp == 1
+
 #if defined(fp16_t) && defined(fp16_surrogate)
 
 #define fp16ro_t __global const fp16_t*
 #define fp16wr_t __global fp16_t*
 
 inline float dot_fp16x4(fp16ro_t const a, fp16ro_t const b) {
-    return dot((float4)*a, (float4)*b);
+    return dot(vload_half4(0, a), vload_half4(0, b));
 }
 
 inline float dot_fp16x8(fp16ro_t a, fp16ro_t b) {
@@ -217,8 +650,8 @@ __kernel void gemv4_fp16(fp16ro_t mx, fp16ro_t v, fp16wr_t r, int32_t n) {
         s += dot_fp16x4(v, m);
         n -= 4; v += 4; m += 4;
     }
-    while (n >= 0) {
-        s += *v++ * *m++; n--;
+    while (n > 0) {
+        s += vload_half(0, v++) * vload_half(0, m++); n--;
     }
     r[i] = (fp16_t)s;
 }
@@ -239,8 +672,8 @@ __kernel void gemv16_fp16(fp16ro_t mx, fp16ro_t v, fp16wr_t r, int32_t n) {
         s += dot_fp16x4(v, m);
         n -= 4; v += 4; m += 4;
     }
-    while (n >= 0) {
-        s += *v++ * *m++; n--;
+    while (n > 0) {
+        s += vload_half(0, v++) * vload_half(0, m++); n--;
     }
     r[i] = (fp16_t)s;
 }
@@ -12,6 +12,17 @@ enum { blast_fpp16 = 0, blast_fpp32 = 1, blast_fpp64 = 2 };
 extern const char* blast_fpp_names[3];
 extern const int   blast_fpp_bytes[3]; // { 2, 4, 8 }
 
+// block quantized matrix storage index
+enum { blast_q8 = 0, blast_q4 = 1 };
+// each row is split into blocks of 32 values with single fp16_t scale:
+// value = scale * q where q: [-127..127] for q8 and [-8..7] for q4.
+// Planar layout in a single memory region:
+//   quants[m][n]   q8: int8_t, q4: uint8_t two nibbles (q + 8), low first
+//   scales[m][n / blast_q_block] fp16_t
+enum { blast_q_block = 32 };
+
+extern const char* blast_q_names[2];
+
 enum { // .allocate()/.map() flags
     blast_access_read  = 0, // not a bitset!
     blast_access_write = 1,
@@ -22,13 +33,88 @@ typedef struct blast_s blast_t;
 
 typedef struct blast_memory_s { // treat as read only, will change don't cache
     void*   m; // mapped memory address in virtual memory. TODO: can be eliminated?
-    void*   h; // handle
+    void*   h; // handle (address for svm)
     int64_t s; // size in bytes
+    bool  svm; // fine grained shared virtual memory
+    bool  recorded; // scratch owned by ocl_graph_t (see ocl.record())
+    void*   root;   // view(): buffer the sub-buffer is created from
+    int64_t origin; // view(): offset of the sub-buffer in root (bytes)
     blast_t* b;
 } blast_memory_t;
 
+// Asynchronous operations return a future. Caller must .wait() for
+// every future exactly once (it releases the event and result memory).
+// Futures can be passed as "after" dependency to other asynchronous ops.
+// Future of an operation recorded into ocl_graph_t has no event and its
+// result memory belongs to the graph: .wait() after each completed
+// .replay() reads the result of that replay (not before the first one).
+
+typedef struct blast_future_s {
+    ocl_event_t e;    // completion event of the last kernel, null: completed
+    blast_memory_t r; // device memory with scalar result or r.h == null
+    int fpp;          // precision of the value in "r"
+} blast_future_t;
+
+typedef struct blast_launch_s { // launch shape chosen by blast planner
+    int64_t groups;   // work-groups in a single NDRange
+    int64_t items;    // work-items per group
+    int64_t per_item; // elements per work-item (grid-stride iterations)
+    int64_t launches; // kernel launches including final reduction
+} blast_launch_t;
+
+typedef struct blast_gemm_tile_s { // gemm() tuning parameters
+    int64_t tile;  // side of square tile of c[][] per work-group step
+    int64_t items; // max work-items per group (each owns <= 4 x 4 of c)
+} blast_gemm_tile_t;
+
+// Launch shapes found by .tune() for each kernel family, precision and
+// problem size bucket floor(log2(elements)). Persisted in the tuning file
+// <ocl.cache.folder>/blast_<hash>.tune (hash of device name and driver
+// version) and loaded by .init(). Zero shape: planner defaults.
+
+enum { blast_tune_dot = 0, blast_tune_gemv = 1, blast_tune_ops = 2 };
+enum { blast_tune_buckets = 32 };
+
+typedef struct blast_shape_s {
+    int32_t items;  // work-items per group
+    int32_t groups; // work-groups per compute unit (work per item factor)
+} blast_shape_t;
+
+typedef struct blast_tuning_s {
+    blast_shape_t shape[blast_tune_ops][3][blast_tune_buckets]; // [op][fpp]
+    int64_t loaded; // number of tuned shapes loaded by .init()
+    char pathname[1024]; // tuning file set by .init(), "": not persisted
+} blast_tuning_t;
+
+// Scratch buffers (partial sums, results of futures) come from per blast_t
+// pool of power of 2 size classes (64 bytes and up) and are reused
+// instead of being allocated and released on every call.
+
+enum { blast_pool_classes = 26, blast_pool_depth = 8 };
+
+typedef struct blast_pool_s {
+    void*   free[blast_pool_classes][blast_pool_depth]; // memory handles
+    int32_t count[blast_pool_classes]; // number of free[class][] buffers
+    int64_t hits;   // requests served from the pool
+    int64_t misses; // requests that had to allocate device memory
+    int64_t bytes;  // bytes held by the pool (free buffers)
+} blast_pool_t;
+
 typedef struct blast_s {
     ocl_context_t* c;
+    blast_launch_t launch; // shape of the last dot() (read only)
+    // initialized by .init() with device defaults, can be tuned by caller,
+    // planner may reduce tile to fit items and local memory limits
+    blast_gemm_tile_t gemm_tile;
+    blast_pool_t pool; // scratch memory pool (read only, see .trim())
+    blast_tuning_t tuning; // launch shapes of dot() and gemv() (see .tune())
+    // programs are built in parallel by .init() and kernels are created
+    // on first use of the precision (both read only)
+    ocl_build_t build[3]; // null when complete or fpp is not supported
+    bool compiled[3];     // kernels[fpp] has been created
+    // dot() reduction: false (default) - single pass work-group reduction
+    // true - legacy log2(n) chain of sum_even/sum_odd kernels (comparison)
+    bool chain;
     // BLAS like operations
     // The offset parameters could be useful when multiple tensors reside in
     // a single memory region.
@@ -37,11 +123,73 @@ typedef struct blast_s {
     fp64_t (*dot[3])(
         blast_memory_t* v0, int64_t offset0, int64_t stride0,
         blast_memory_t* v1, int64_t offset1, int64_t stride1, int64_t n);
-    // gemv()
+    // dot_async() enqueues all kernels and returns immediately
+    // after (can be null) - future that must complete before this op starts
+    blast_future_t (*dot_async[3])(
+        blast_memory_t* v0, int64_t offset0, int64_t stride0,
+        blast_memory_t* v1, int64_t offset1, int64_t stride1, int64_t n,
+        const blast_future_t* after);
+    // dot_batched() computes "count" independent dots in a single launch:
+    //   r[offset + k] = dot(v0 + k * batch0, v1 + k * batch1), k: [0..count-1]
+    // offsets and strides are in elements, r[] elements are of the same
+    // fp precision, batch0 == 0 broadcasts v0 against every v1.
+    // Returned future has no scalar result: blast.wait() returns 0.
+    blast_future_t (*dot_batched[3])(
+        blast_memory_t* v0, int64_t offset0, int64_t stride0, int64_t batch0,
+        blast_memory_t* v1, int64_t offset1, int64_t stride1, int64_t batch1,
+        blast_memory_t* r,  int64_t offset, int64_t n, int64_t count,
+        const blast_future_t* after);
+    // gemv() result[i] = dot(matrix row i, vector) for i: [0..m - 1]
+    // stride_m is distance between starts of adjacent rows (>= n) and
+    // stride_v is distance between vector elements. Both in elements.
     void (*gemv[3])(
         blast_memory_t* matrix/*[m][n]*/, int64_t offset_m, int64_t stride_m,
         blast_memory_t* vector/*[n]*/,    int64_t offset_v, int64_t stride_v,
         blast_memory_t* result/*[m]*/, int64_t m, int64_t n);
+    // gemv_async() enqueues gemv() and returns immediately (no scalar result)
+    blast_future_t (*gemv_async[3])(
+        blast_memory_t* matrix/*[m][n]*/, int64_t offset_m, int64_t stride_m,
+        blast_memory_t* vector/*[n]*/,    int64_t offset_v, int64_t stride_v,
+        blast_memory_t* result/*[m]*/, int64_t m, int64_t n,
+        const blast_future_t* after);
+    // gemv_mixed() fp16 matrix (weights) times vector of vector_fpp
+    // (blast_fpp16 or blast_fpp32) precision with fp32 accumulation.
+    // Result is stored as result_fpp (blast_fpp16 or blast_fpp32).
+    // Available even if device does not support fp16 arithmetic.
+    void (*gemv_mixed)(
+        blast_memory_t* matrix/*[m][n]*/, int64_t offset_m, int64_t stride_m,
+        blast_memory_t* vector/*[n]*/,    int64_t offset_v, int64_t stride_v,
+        int vector_fpp, blast_memory_t* result/*[m]*/, int result_fpp,
+        int64_t m, int64_t n);
+    blast_future_t (*gemv_mixed_async)(
+        blast_memory_t* matrix/*[m][n]*/, int64_t offset_m, int64_t stride_m,
+        blast_memory_t* vector/*[n]*/,    int64_t offset_v, int64_t stride_v,
+        int vector_fpp, blast_memory_t* result/*[m]*/, int result_fpp,
+        int64_t m, int64_t n, const blast_future_t* after);
+    // gemv_q() block quantized matrix (see blast.quantize()) times fp32
+    // vector with fp32 accumulation and fp32 result. n % blast_q_block == 0
+    void (*gemv_q[2])(blast_memory_t* matrix/*packed [m][n]*/,
+        blast_memory_t* vector/*[n]*/, int64_t offset_v, int64_t stride_v,
+        blast_memory_t* result/*[m]*/, int64_t m, int64_t n);
+    blast_future_t (*gemv_q_async[2])(blast_memory_t* matrix/*packed [m][n]*/,
+        blast_memory_t* vector/*[n]*/, int64_t offset_v, int64_t stride_v,
+        blast_memory_t* result/*[m]*/, int64_t m, int64_t n,
+        const blast_future_t* after);
+    // gemm() c[m][n] = a[m][k] * b[k][n] row major matrices.
+    // Leading dimensions lda >= k, ldb >= n, ldc >= n and offsets are in
+    // elements. Accumulates in fp32 for fp16 and fp32, fp64 for fp64.
+    void (*gemm[3])(
+        blast_memory_t* a/*[m][k]*/, int64_t offset_a, int64_t lda,
+        blast_memory_t* b/*[k][n]*/, int64_t offset_b, int64_t ldb,
+        blast_memory_t* c/*[m][n]*/, int64_t offset_c, int64_t ldc,
+        int64_t m, int64_t n, int64_t k);
+    // gemm_mixed() fp16 a and b, fp32 accumulation, fp32 c
+    // available even if device does not support fp16 arithmetic
+    void (*gemm_mixed)(
+        blast_memory_t* a/*[m][k]*/, int64_t offset_a, int64_t lda,
+        blast_memory_t* b/*[k][n]*/, int64_t offset_b, int64_t ldb,
+        blast_memory_t* c/*[m][n]*/, int64_t offset_c, int64_t ldc,
+        int64_t m, int64_t n, int64_t k);
     // kernels are properties of c.c ocl_context:
     ocl_kernel_t dot_c[3];   // compact
     ocl_kernel_t dot_os[3];  // offset + stride
@@ -49,8 +197,17 @@ typedef struct blast_s {
     ocl_kernel_t sum_odd_os[3];
     ocl_kernel_t sum_even[3];
     ocl_kernel_t sum_even_os[3];
+    ocl_kernel_t dot_reduce[3];    // dot() + work-group reduction
+    ocl_kernel_t dot_reduce_os[3]; // offset + stride
+    ocl_kernel_t sum_reduce[3];    // single work-group final pass
+    ocl_kernel_t dot_batched_k[3]; // work-group per vector pair
     ocl_kernel_t gemv_c[3];
     ocl_kernel_t gemv_os[3];
+    ocl_kernel_t gemv_tiled[3]; // work-group per block of rows
+    ocl_kernel_t gemv_mixed_k;  // fp16 matrix fp32 accumulation
+    ocl_kernel_t gemv_q_k[2];   // blast_q8, blast_q4 matrix
+    ocl_kernel_t gemm_k[3];     // local memory tiled
+    ocl_kernel_t gemm_mixed_k;  // fp16 a, b fp32 accumulation and c
     // TODO:
     // TODO:
     ocl_kernel_t copy[3]; // for performance measurements
@@ -59,22 +216,123 @@ typedef struct blast_s {
     ocl_kernel_t mad_os[3];
 } blast_t;
 
+// Threads: blast_t (kernels, scratch pool) and its context are used by
+// one thread at a time. Each submitting thread .clone()-s blast_t onto
+// its own ocl.fork() of the context and accesses memory allocated by
+// other blast_t through .share() aliases. Operations run on blast_t of
+// the first memory argument (blast_memory_t.b).
+
 typedef struct blast_if {
     void (*init)(blast_t* b, ocl_context_t* c);
+    // clone() "from" onto "c" with the same OpenCL context (ocl.fork()).
+    // Must be called on the thread that uses "from" (finishes pending
+    // builds of "from"). Release with .fini().
+    void (*clone)(blast_t* b, blast_t* from, ocl_context_t* c);
    // Only the memory allocated by blast.allocate() can be used as an arguments.
     // Caller MUST unmap that memory to allow access to it by the GPU.
     // and will remap it back when done. The address WILL CHANGE!
+    // (except for memory from .allocate_svm() see below)
     blast_memory_t (*allocate)(blast_t* b, int access, int64_t bytes);
+    // wrap() caller owned page aligned host memory (e.g. memory mapped
+    // weights) without copying (see ocl.wrap()). Memory is used in place
+    // by devices with unified_memory. .map()/.unmap() rules still apply,
+    // .deallocate() does not free "data".
+    blast_memory_t (*wrap)(blast_t* b, int access, void* data, int64_t bytes);
+    // allocate_svm() requires fine grained buffer SVM (OpenCL 2.0+, see
+    // ocl.devices[].svm). Host and kernels share the same address: map()
+    // returns it without enqueuing commands and unmap() is a no-op, thus
+    // the address does NOT change and map/unmap around every operation
+    // is unnecessary. Host must still wait for futures of operations
+    // writing the memory before reading it. Cannot have views.
+    blast_memory_t (*allocate_svm)(blast_t* b, int access, int64_t bytes);
+    // view() of "bytes" at "offset" of "gm" is independent compact memory
+    // (sub-buffer) for the kernels, thus tensors packed in a single arena
+    // do not need offset arguments. "offset" must be a multiple of
+    // ocl.devices[].base_align. Deallocate view before "gm". View of a
+    // view is a sub-buffer of the same root buffer (OpenCL does not allow
+    // sub-buffers of sub-buffers).
+    blast_memory_t (*view)(blast_memory_t* gm, int64_t offset, int64_t bytes);
+    // share() alias of "gm" for operations on "b". Alias is not mapped
+    // and must not be deallocated (it is released with "gm").
+    blast_memory_t (*share)(blast_memory_t* gm, blast_t* b);
     void  (*deallocate)(blast_memory_t* gm);
     // Client must map blast_memory to host memory before accessing it
     // and unmap before invocation of any other blast operation
     void* (*map)(blast_memory_t* gm, int access, int64_t offset, int64_t bytes);
     void  (*unmap)(blast_memory_t* gm);
+    // scratch() returns read/write memory of at least "bytes" from the
+    // pool of blast_t, release() returns it back to the pool
+    blast_memory_t (*scratch)(blast_t* b, int64_t bytes);
+    void  (*release)(blast_memory_t* gm);
+    // trim() deallocates free pooled buffers until pool holds <= keep bytes
+    void  (*trim)(blast_t* b, int64_t keep);
+    // tune() times candidate launch shapes of dot() and gemv() for all
+    // problem size buckets up to "n" elements with profiling events
+    // (requires profiling context) and saves winners to the tuning file
+    void  (*tune)(blast_t* b, int64_t n);
+    // non-blocking poll: true if result of asynchronous op is ready
+    bool   (*ready)(blast_future_t* f);
+    // blocks until completion, returns result and releases the future
+    fp64_t (*wait)(blast_future_t* f);
     void (*fini)(blast_t* b);
+    // host side block quantization (blast_q8, blast_q4) of x[m][n] to
+    // planar layout described above. n % blast_q_block must be 0.
+    int64_t (*quantized_bytes)(int q, int64_t m, int64_t n);
+    void (*quantize)(int q, const fp32_t* x, int64_t m, int64_t n,
+        void* packed);
+    void (*dequantize)(int q, const void* packed, int64_t m, int64_t n,
+        fp32_t* x);
+    // CPU reference of gemv_q() for validation: r[m] = packed[m][n] * v[n]
+    void (*gemv_q_reference)(int q, const void* packed, int64_t m, int64_t n,
+        const fp32_t* v, fp32_t* r);
 } blast_if;
 
 extern blast_if blast;
 
+// Multi-device blast: blast_t and context per device. Sharded tensor
+// keeps rows [from[i]..from[i + 1]) on device i, row shares proportional
+// to throughput measured by .calibrate() (equal after .open()).
+// Operations enqueue work on all devices before waiting for any of them
+// and merge results on host. blast_multi_t must not be moved after
+// .open() (blast_t keeps address of its context).
+
+enum { blast_max_devices = 8 };
+
+typedef struct blast_multi_s {
+    int32_t count;
+    ocl_context_t c[blast_max_devices];
+    blast_t b[blast_max_devices];
+    double share[blast_max_devices]; // fraction of rows (sum is 1.0)
+} blast_multi_t;
+
+typedef struct blast_sharded_s {
+    blast_multi_t* mb;
+    int fpp;
+    int64_t rows;
+    int64_t columns; // 1 for vectors
+    int64_t from[blast_max_devices + 1]; // first row of device i
+    blast_memory_t m[blast_max_devices]; // m[i].h == null: no rows
+} blast_sharded_t;
+
+typedef struct blast_multi_if {
+    // devices[count] indices of ocl.devices[] (see ocl.sub_devices())
+    void (*open)(blast_multi_t* mb, int32_t count, const int32_t devices[]);
+    // measures fp32 gemv() throughput of each device and sets share[]
+    void (*calibrate)(blast_multi_t* mb);
+    // uploads data[rows][columns] of "fpp" split by current share[]
+    blast_sharded_t (*shard)(blast_multi_t* mb, int fpp, const void* data,
+        int64_t rows, int64_t columns);
+    void (*unshard)(blast_sharded_t* s);
+    // dot() of two sharded vectors with identical split
+    fp64_t (*dot)(blast_sharded_t* v0, blast_sharded_t* v1);
+    // gemv() r[rows] = mx[rows][columns] * v[columns] where "v" and "r"
+    // are host arrays of mx->fpp precision
+    void (*gemv)(blast_sharded_t* mx, const void* v, void* r);
+    void (*close)(blast_multi_t* mb);
+} blast_multi_if;
+
+extern blast_multi_if blast_multi;
+
 #ifdef __cplusplus
 }
 #endif
@@ -97,7 +355,7 @@ extern blast_if blast;
         dsdot
 
     Level 2 BLAS (6 subprograms):
-    [ ] gemv
+    [x] gemv
         gbmv
         hemv
         hbmv
@@ -105,7 +363,7 @@ extern blast_if blast;
         sbmv
 
     Level 3 BLAS (4 subprograms)
-        gemm
+    [x] gemm
         symm
         hemm
         syrk
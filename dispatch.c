@@ -0,0 +1,445 @@
+#include "rt.h"
+#include "dispatch.h"
+
+// Operand host access: svm and mapped memory are used in place, unmapped
+// memory is mapped for the duration of the CPU path.
+
+typedef struct dispatch_host_s {
+    blast_memory_t* gm;
+    uint8_t* p;  // host address of gm element 0
+    bool mapped; // mapped by dispatcher
+} dispatch_host_t;
+
+static bool dispatch_resident(blast_memory_t* gm) {
+    return gm->svm || gm->m != null;
+}
+
+static dispatch_host_t dispatch_map(blast_memory_t* gm, int access) {
+    dispatch_host_t h = { .gm = gm, .p = null, .mapped = false };
+    if (gm->svm) {
+        h.p = (uint8_t*)gm->h;
+    } else if (gm->m != null) {
+        h.p = (uint8_t*)gm->m;
+    } else {
+        h.p = (uint8_t*)blast.map(gm, access, 0, gm->s);
+        h.mapped = true;
+    }
+    return h;
+}
+
+static void dispatch_unmap(dispatch_host_t* h) {
+    if (h->mapped) { blast.unmap(h->gm); }
+}
+
+// Device path: host resident operands are unmapped for the operation
+// and mapped back afterwards.
+
+static bool dispatch_release(blast_memory_t* gm) {
+    const bool remap = !gm->svm && gm->m != null;
+    if (remap) { blast.unmap(gm); }
+    return remap;
+}
+
+static void dispatch_restore(blast_memory_t* gm, bool remap) {
+    if (remap) { blast.map(gm, blast_access_rw, 0, gm->s); }
+}
+
+static fp64_t dispatch_cpu_dot(int fpp, const void* v0, int64_t s0,
+        const void* v1, int64_t s1, int64_t n) {
+    switch (fpp) {
+        case blast_fpp16:
+            return dot16((const fp16_t*)v0, s0, (const fp16_t*)v1, s1, n);
+        case blast_fpp32:
+            return dot32((const fp32_t*)v0, s0, (const fp32_t*)v1, s1, n);
+        case blast_fpp64:
+            return dot64((const fp64_t*)v0, s0, (const fp64_t*)v1, s1, n);
+        default: fatal_if(true, "fpp: %d", fpp); return 0;
+    }
+}
+
+static void dispatch_cpu_gemv(int fpp, const uint8_t* mx, int64_t sm,
+        const uint8_t* v, int64_t sv, uint8_t* r, int64_t m, int64_t n) {
+    const int64_t bytes = blast_fpp_bytes[fpp];
+    for (int64_t i = 0; i < m; i++) {
+        const fp64_t s = dispatch_cpu_dot(fpp, mx + i * sm * bytes, 1,
+                                          v, sv, n);
+        switch (fpp) {
+            case blast_fpp16: ((fp16_t*)r)[i] = fp32to16((fp32_t)s); break;
+            case blast_fpp32: ((fp32_t*)r)[i] = (fp32_t)s; break;
+            case blast_fpp64: ((fp64_t*)r)[i] = s; break;
+            default: fatal_if(true, "fpp: %d", fpp);
+        }
+    }
+}
+
+static bool dispatch_on_device(dispatch_t* d, bool gemv, int fpp,
+        int residency, int64_t elements) {
+    const int64_t crossover = gemv ? d->gemv[fpp][residency] :
+                                     d->dot[fpp][residency];
+    return elements >= crossover;
+}
+
+static fp64_t dispatch_dot(dispatch_t* d, int fpp,
+        blast_memory_t* v0, int64_t o0, int64_t s0,
+        blast_memory_t* v1, int64_t o1, int64_t s1, int64_t n) {
+    const int residency = dispatch_resident(v0) && dispatch_resident(v1) ?
+        dispatch_host : dispatch_device;
+    fp64_t r = 0;
+    if (dispatch_on_device(d, false, fpp, residency, n)) {
+        const bool remap0 = dispatch_release(v0);
+        const bool remap1 = v1 != v0 && dispatch_release(v1);
+        r = d->b->dot[fpp](v0, o0, s0, v1, o1, s1, n);
+        dispatch_restore(v1, remap1);
+        dispatch_restore(v0, remap0);
+    } else {
+        const int64_t bytes = blast_fpp_bytes[fpp];
+        dispatch_host_t h0 = dispatch_map(v0, blast_access_read);
+        dispatch_host_t h1 = v1 != v0 ?
+            dispatch_map(v1, blast_access_read) : h0;
+        r = dispatch_cpu_dot(fpp, h0.p + o0 * bytes, s0,
+                                  h1.p + o1 * bytes, s1, n);
+        if (v1 != v0) { dispatch_unmap(&h1); }
+        dispatch_unmap(&h0);
+    }
+    return r;
+}
+
+static void dispatch_gemv(dispatch_t* d, int fpp,
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* v,  int64_t ov, int64_t sv,
+        blast_memory_t* r, int64_t m, int64_t n) {
+    fatal_if(r->h == mx->h || r->h == v->h, "result aliases operand");
+    const int residency = dispatch_resident(mx) && dispatch_resident(v) &&
+        dispatch_resident(r) ? dispatch_host : dispatch_device;
+    if (dispatch_on_device(d, true, fpp, residency, m * n)) {
+        const bool remap_m = dispatch_release(mx);
+        const bool remap_v = v != mx && dispatch_release(v);
+        const bool remap_r = dispatch_release(r);
+        d->b->gemv[fpp](mx, om, sm, v, ov, sv, r, m, n);
+        dispatch_restore(r,  remap_r);
+        dispatch_restore(v,  remap_v);
+        dispatch_restore(mx, remap_m);
+    } else {
+        const int64_t bytes = blast_fpp_bytes[fpp];
+        dispatch_host_t hm = dispatch_map(mx, blast_access_read);
+        dispatch_host_t hv = v != mx ?
+            dispatch_map(v, blast_access_read) : hm;
+        dispatch_host_t hr = dispatch_map(r, blast_access_write);
+        dispatch_cpu_gemv(fpp, hm.p + om * bytes, sm, hv.p + ov * bytes, sv,
+                          hr.p, m, n);
+        dispatch_unmap(&hr);
+        if (v != mx) { dispatch_unmap(&hv); }
+        dispatch_unmap(&hm);
+    }
+}
+
+// Calibration times both paths for both residencies at sizes growing
+// 4 times from 4K elements. Crossover is the smallest measured size from
+// which the device stays faster for all larger measured sizes.
+
+enum { dispatch_min_log2 = 12, dispatch_sizes = 8, dispatch_best_of = 3 };
+
+typedef struct dispatch_timing_s {
+    int64_t n[dispatch_sizes];
+    double  cpu[dispatch_sizes][2]; // [size][residency] seconds
+    double  gpu[dispatch_sizes][2];
+    int     count;
+} dispatch_timing_t;
+
+static int64_t dispatch_crossover(const dispatch_timing_t* t, int residency) {
+    int64_t crossover = dispatch_never;
+    for (int i = t->count - 1; i >= 0; i--) {
+        if (t->gpu[i][residency] >= t->cpu[i][residency]) { break; }
+        crossover = t->n[i];
+    }
+    return crossover;
+}
+
+static void dispatch_fill(blast_memory_t* gm, int fpp, int64_t count) {
+    uint8_t* p = (uint8_t*)blast.map(gm, blast_access_write, 0, gm->s);
+    for (int64_t i = 0; i < count; i++) { // small integers: exact results
+        const fp32_t x = (fp32_t)(i % 3) - 1.0f;
+        switch (fpp) {
+            case blast_fpp16: ((fp16_t*)p)[i] = fp32to16(x); break;
+            case blast_fpp32: ((fp32_t*)p)[i] = x; break;
+            case blast_fpp64: ((fp64_t*)p)[i] = x; break;
+            default: fatal_if(true, "fpp: %d", fpp);
+        }
+    }
+    blast.unmap(gm);
+}
+
+static double dispatch_time(dispatch_t* d, bool gemv, int fpp, bool device,
+        int residency, blast_memory_t* a, blast_memory_t* x,
+        blast_memory_t* r, int64_t n) {
+    // force the path by crossover of the measured entry
+    int64_t* crossover = gemv ? &d->gemv[fpp][residency] :
+                                &d->dot[fpp][residency];
+    const int64_t saved = *crossover;
+    *crossover = device ? 0 : dispatch_never;
+    if (residency == dispatch_host) {
+        blast.map(a, blast_access_rw, 0, a->s);
+        blast.map(x, blast_access_rw, 0, x->s);
+        if (gemv) { blast.map(r, blast_access_rw, 0, r->s); }
+    }
+    // square matrix for gemv: n is m * m
+    const int64_t m = gemv ? (int64_t)sqrt((double)n) : 0;
+    double best = DBL_MAX;
+    for (int i = 0; i < dispatch_best_of; i++) {
+        double time = seconds();
+        if (gemv) {
+            dispatch_gemv(d, fpp, a, 0, m, x, 0, 1, r, m, m);
+        } else {
+            dispatch_dot(d, fpp, a, 0, 1, x, 0, 1, n);
+        }
+        time = seconds() - time;
+        best = min(best, time);
+    }
+    if (residency == dispatch_host) {
+        if (gemv) { blast.unmap(r); }
+        blast.unmap(x);
+        blast.unmap(a);
+    }
+    *crossover = saved;
+    return best;
+}
+
+static void dispatch_calibrate(dispatch_t* d, bool gemv, int fpp,
+        int64_t max_n) {
+    blast_t* b = d->b;
+    const int64_t bytes = blast_fpp_bytes[fpp];
+    dispatch_timing_t t = {0};
+    for (int64_t n = 1LL << dispatch_min_log2;
+         n <= max_n && t.count < dispatch_sizes; n *= 4) {
+        // operands sized for n: map() and unmap() of host residency and
+        // of the CPU path cover exactly the elements the operation uses
+        const int64_t m = gemv ? (int64_t)sqrt((double)n) : 1;
+        const int64_t k = gemv ? m : n; // elements of x
+        blast_memory_t a = blast.allocate(b, blast_access_rw, n * bytes);
+        blast_memory_t x = blast.allocate(b, blast_access_rw, k * bytes);
+        blast_memory_t r = blast.allocate(b, blast_access_rw, m * bytes);
+        dispatch_fill(&a, fpp, n);
+        dispatch_fill(&x, fpp, k);
+        t.n[t.count] = n;
+        for (int residency = 0; residency < 2; residency++) {
+            t.cpu[t.count][residency] = dispatch_time(d, gemv, fpp, false,
+                residency, &a, &x, &r, n);
+            t.gpu[t.count][residency] = dispatch_time(d, gemv, fpp, true,
+                residency, &a, &x, &r, n);
+        }
+        blast.deallocate(&r);
+        blast.deallocate(&x);
+        blast.deallocate(&a);
+        d->calibrated = max(d->calibrated, n);
+        t.count++;
+    }
+    for (int residency = 0; residency < 2; residency++) {
+        int64_t* crossover = gemv ? &d->gemv[fpp][residency] :
+                                    &d->dot[fpp][residency];
+        *crossover = dispatch_crossover(&t, residency);
+    }
+}
+
+static void dispatch_init(dispatch_t* d, blast_t* b, int64_t n) {
+    memset(d, 0, sizeof(*d));
+    d->b = b;
+    for (int fpp = blast_fpp16; fpp <= blast_fpp64; fpp++) {
+        for (int residency = 0; residency < 2; residency++) {
+            d->dot[fpp][residency]  = dispatch_never;
+            d->gemv[fpp][residency] = dispatch_never;
+        }
+        const double share = b->dot[fpp] != null ? 0.5 : 0;
+        d->share[fpp][0] = share;
+        d->share[fpp][1] = share;
+        if (b->dot[fpp] != null) {
+            dispatch_calibrate(d, false, fpp, n);
+            dispatch_calibrate(d, true,  fpp, n);
+        }
+    }
+}
+
+// Co-execution: CPU reads its part through ocl.map() of the exact range
+// (not blast.map() because the same memory can be mapped twice).
+
+typedef struct dispatch_range_s {
+    blast_memory_t* gm;
+    uint8_t* p; // host address of the first element of the range
+} dispatch_range_t;
+
+static dispatch_range_t dispatch_map_range(blast_memory_t* gm, int fpp,
+        int64_t offset, int64_t stride, int64_t count) {
+    const int64_t bytes = blast_fpp_bytes[fpp];
+    const int64_t from = offset * bytes;
+    const int64_t to = (offset + (count - 1) * stride + 1) * bytes;
+    dispatch_range_t r = { .gm = gm, .p = null };
+    if (gm->svm) {
+        r.p = (uint8_t*)gm->h + from;
+    } else {
+        r.p = (uint8_t*)ocl.map(gm->b->c, ocl_map_read, (ocl_memory_t)gm->h,
+                                from, to - from);
+    }
+    return r;
+}
+
+static void dispatch_unmap_range(dispatch_range_t* r) {
+    if (!r->gm->svm) {
+        ocl.unmap(r->gm->b->c, (ocl_memory_t)r->gm->h, r->p);
+    }
+}
+
+static int64_t dispatch_split_at(double share, int64_t n) {
+    return max(0, min(n, (int64_t)(n * share + 0.5)));
+}
+
+static fp64_t dispatch_dot_split(dispatch_t* d, int fpp,
+        blast_memory_t* v0, int64_t o0, int64_t s0,
+        blast_memory_t* v1, int64_t o1, int64_t s1, int64_t n) {
+    const int64_t k = dispatch_split_at(d->share[fpp][0], n); // device [0, k)
+    const bool remap0 = dispatch_release(v0);
+    const bool remap1 = v1 != v0 && dispatch_release(v1);
+    fp64_t sum = 0;
+    if (k < n) {
+        // map before enqueue: blocking map would wait for device part
+        dispatch_range_t h0 = dispatch_map_range(v0, fpp, o0 + k * s0, s0,
+                                                 n - k);
+        dispatch_range_t h1 = dispatch_map_range(v1, fpp, o1 + k * s1, s1,
+                                                 n - k);
+        blast_future_t f = {0};
+        if (k > 0) {
+            f = d->b->dot_async[fpp](v0, o0, s0, v1, o1, s1, k, null);
+        }
+        sum = dispatch_cpu_dot(fpp, h0.p, s0, h1.p, s1, n - k);
+        if (k > 0) { sum += blast.wait(&f); }
+        dispatch_unmap_range(&h1);
+        dispatch_unmap_range(&h0);
+    } else {
+        sum = d->b->dot[fpp](v0, o0, s0, v1, o1, s1, n);
+    }
+    dispatch_restore(v1, remap1);
+    dispatch_restore(v0, remap0);
+    return sum;
+}
+
+static void dispatch_gemv_split(dispatch_t* d, int fpp,
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* v,  int64_t ov, int64_t sv,
+        blast_memory_t* r, int64_t m, int64_t n) {
+    fatal_if(r->h == mx->h || r->h == v->h, "result aliases operand");
+    const int64_t k = dispatch_split_at(d->share[fpp][1], m); // device rows
+    const int64_t bytes = blast_fpp_bytes[fpp];
+    const bool remap_m = dispatch_release(mx);
+    const bool remap_v = v != mx && dispatch_release(v);
+    const bool remap_r = dispatch_release(r);
+    if (k < m) {
+        // CPU rows [k, m) are computed to host memory and written into
+        // "r" after device rows [0, k) are done
+        const int64_t rows = m - k;
+        uint8_t* tail = (uint8_t*)malloc(rows * bytes);
+        fatal_if(tail == null);
+        dispatch_range_t hm = dispatch_map_range(mx, fpp, om + k * sm, 1,
+                                                 (rows - 1) * sm + n);
+        dispatch_range_t hv = dispatch_map_range(v, fpp, ov, sv, n);
+        blast_future_t f = {0};
+        if (k > 0) {
+            f = d->b->gemv_async[fpp](mx, om, sm, v, ov, sv, r, k, n, null);
+        }
+        dispatch_cpu_gemv(fpp, hm.p, sm, hv.p, sv, tail, rows, n);
+        if (k > 0) { blast.wait(&f); }
+        dispatch_unmap_range(&hv);
+        dispatch_unmap_range(&hm);
+        if (r->svm) {
+            memcpy((uint8_t*)r->h + k * bytes, tail, rows * bytes);
+        } else {
+            ocl_event_t e = ocl.write(r->b->c, (ocl_memory_t)r->h,
+                k * bytes, rows * bytes, tail, 0, null);
+            ocl.wait(&e, 1);
+            ocl.release_event(e);
+        }
+        free(tail);
+    } else {
+        d->b->gemv[fpp](mx, om, sm, v, ov, sv, r, m, n);
+    }
+    dispatch_restore(r,  remap_r);
+    dispatch_restore(v,  remap_v);
+    dispatch_restore(mx, remap_m);
+}
+
+static double dispatch_split_time(dispatch_t* d, bool gemv, int fpp,
+        double share, blast_memory_t* a, blast_memory_t* x,
+        blast_memory_t* r, int64_t n) {
+    const double saved = d->share[fpp][gemv];
+    d->share[fpp][gemv] = share;
+    const int64_t m = gemv ? (int64_t)sqrt((double)n) : 0;
+    double best = DBL_MAX;
+    for (int i = 0; i < dispatch_best_of; i++) {
+        double time = seconds();
+        if (gemv) {
+            dispatch_gemv_split(d, fpp, a, 0, m, x, 0, 1, r, m, m);
+        } else {
+            dispatch_dot_split(d, fpp, a, 0, 1, x, 0, 1, n);
+        }
+        time = seconds() - time;
+        best = min(best, time);
+    }
+    d->share[fpp][gemv] = saved;
+    return best;
+}
+
+static void dispatch_balance(dispatch_t* d, int64_t n) {
+    blast_t* b = d->b;
+    for (int fpp = blast_fpp16; fpp <= blast_fpp64; fpp++) {
+        if (b->dot[fpp] == null) { continue; }
+        const int64_t bytes = blast_fpp_bytes[fpp];
+        blast_memory_t a = blast.allocate(b, blast_access_rw, n * bytes);
+        blast_memory_t x = blast.allocate(b, blast_access_rw, n * bytes);
+        blast_memory_t r = blast.allocate(b, blast_access_rw,
+            ((int64_t)sqrt((double)n) + 1) * bytes);
+        dispatch_fill(&a, fpp, n);
+        dispatch_fill(&x, fpp, n);
+        for (int op = 0; op < 2; op++) {
+            // throughput ratio: both sides finish together when device
+            // share is cpu / (cpu + device) of the single side times
+            const double cpu = dispatch_split_time(d, op, fpp, 0,
+                                                   &a, &x, &r, n);
+            const double gpu = dispatch_split_time(d, op, fpp, 1,
+                                                   &a, &x, &r, n);
+            d->share[fpp][op] = cpu / (cpu + gpu);
+        }
+        blast.deallocate(&r);
+        blast.deallocate(&x);
+        blast.deallocate(&a);
+    }
+}
+
+static void dispatch_dump(dispatch_t* d) {
+    traceln("%s crossover (elements) calibrated up to %lld",
+            ocl.devices[d->b->c->ix].name, d->calibrated);
+    traceln("      dot: device    host  gemv: device    host  "
+            "split: dot  gemv");
+    for (int fpp = blast_fpp16; fpp <= blast_fpp64; fpp++) {
+        char text[4][32];
+        const int64_t* x[4] = { &d->dot[fpp][0],  &d->dot[fpp][1],
+                                &d->gemv[fpp][0], &d->gemv[fpp][1] };
+        for (int i = 0; i < 4; i++) {
+            if (*x[i] == dispatch_never) {
+                snprintf(text[i], countof(text[i]), "cpu");
+            } else {
+                snprintf(text[i], countof(text[i]), "%lld", *x[i]);
+            }
+        }
+        traceln("%s %12s %7s %12s %7s %11.2f %5.2f", blast_fpp_names[fpp],
+                text[0], text[1], text[2], text[3],
+                d->share[fpp][0], d->share[fpp][1]);
+    }
+}
+
+dispatch_if dispatch = {
+    .init       = dispatch_init,
+    .dot        = dispatch_dot,
+    .gemv       = dispatch_gemv,
+    .dot_split  = dispatch_dot_split,
+    .gemv_split = dispatch_gemv_split,
+    .balance    = dispatch_balance,
+    .on_device  = dispatch_on_device,
+    .dump       = dispatch_dump
+};
@@ -0,0 +1,73 @@
+#pragma once
+#include "blast.h"
+#include "dot.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Size aware dispatcher: dot() and gemv() on blast memory take the
+// faster of the CPU (dot.c AVX2/AVX512) and the device (blast) path for
+// each call. Choice depends on precision, number of elements and data
+// residency: memory is host resident when it is svm or is mapped by
+// blast.map(gm, access, 0, gm->s) and device resident when unmapped.
+// The CPU path maps device resident operands for the call, the device
+// path unmaps host resident operands and maps them back (rw) after the
+// call (address WILL CHANGE, see blast.h). Same struct passed as two
+// operands is mapped once, separate structs over the same buffer (e.g.
+// blast.share() aliases) are unmapped and mapped back each on its own.
+// Crossover sizes are measured by .init() with the same transitions
+// included in the timing.
+
+enum { dispatch_device = 0, dispatch_host = 1 }; // residency index
+
+#define dispatch_never INT64_MAX // crossover: device is never faster
+
+typedef struct dispatch_s {
+    blast_t* b;
+    // smallest number of elements for which the device path is faster
+    int64_t dot[3][2];  // [fpp][residency] n
+    int64_t gemv[3][2]; // [fpp][residency] m * n
+    int64_t calibrated; // largest measured number of elements
+    // co-execution: fraction of elements (dot) or rows (gemv) computed on
+    // device while CPU computes the rest, measured by .balance()
+    double share[3][2]; // [fpp][0: dot, 1: gemv]
+} dispatch_t;
+
+typedef struct dispatch_if {
+    // measures crossovers for problem sizes up to "n" elements
+    void (*init)(dispatch_t* d, blast_t* b, int64_t n);
+    fp64_t (*dot)(dispatch_t* d, int fpp,
+        blast_memory_t* v0, int64_t offset0, int64_t stride0,
+        blast_memory_t* v1, int64_t offset1, int64_t stride1, int64_t n);
+    // r[m] = mx[m][n] * v[n] all of "fpp" precision
+    void (*gemv)(dispatch_t* d, int fpp,
+        blast_memory_t* mx, int64_t offset_m, int64_t stride_m,
+        blast_memory_t* v,  int64_t offset_v, int64_t stride_v,
+        blast_memory_t* r, int64_t m, int64_t n);
+    // Co-execution of a single operation: device computes the head of
+    // the vectors (rows of the matrix) asynchronously while CPU computes
+    // the tail on host mapping of the same memory (map for read while
+    // kernels only read is allowed), partial results are merged on host.
+    // Host resident operands are unmapped and mapped back like .dot().
+    fp64_t (*dot_split)(dispatch_t* d, int fpp,
+        blast_memory_t* v0, int64_t offset0, int64_t stride0,
+        blast_memory_t* v1, int64_t offset1, int64_t stride1, int64_t n);
+    void (*gemv_split)(dispatch_t* d, int fpp,
+        blast_memory_t* mx, int64_t offset_m, int64_t stride_m,
+        blast_memory_t* v,  int64_t offset_v, int64_t stride_v,
+        blast_memory_t* r, int64_t m, int64_t n);
+    // measures CPU only and device only split operations of "n" elements
+    // and sets share[][] so that both sides finish at the same time
+    void (*balance)(dispatch_t* d, int64_t n);
+    // true if operation of "elements" with given residency runs on device
+    bool (*on_device)(dispatch_t* d, bool gemv, int fpp, int residency,
+        int64_t elements);
+    void (*dump)(dispatch_t* d); // traces crossover table
+} dispatch_if;
+
+extern dispatch_if dispatch;
+
+#ifdef __cplusplus
+}
+#endif
@@ -94,8 +94,7 @@ static fp64_t dot16_c(const fp16_t *v0, const fp16_t* v1, int64_t n) {
 
 static fp64_t dot32_c(const fp32_t *v0, const fp32_t* v1, int64_t n) {
     prefetch2_L1L2L3(v0, v1);
-    static bool init;
-    if (!init) { avx2.init(); avx512.init(); init = true;}
+    dot_init();
     if (n >= 16 && avx512.dot32_c != null) {
         return avx512.dot32_c(v0, v1, n);
     } else if (n >= 8 && avx2.dot32_c != null) {
@@ -107,8 +106,7 @@ static fp64_t dot32_c(const fp32_t *v0, const fp32_t* v1, int64_t n) {
 
 static fp64_t dot64_c(const fp64_t *v0, const fp64_t* v1, int64_t n) {
     prefetch2_L1L2L3(v0, v1);
-    static bool init;
-    if (!init) { avx2.init(); avx512.init(); init = true;}
+    dot_init();
     if (n >= 8 && avx512.dot64_c != null) {
         return avx512.dot64_c(v0, v1, n);
     } else if (n >= 4 && avx2.dot64_c != null) {
@@ -501,9 +499,11 @@ static void dot_test_performance() {
     performance(128,  25, &p, measure_dot64); report_preformance(&p, "fp64 RAM");
 }
 
-void dot_init() {
-    static bool init;
-    if (!init) { avx2.init(); avx512.init(); init = true; }
+static void dot_init_once(void) { avx2.init(); avx512.init(); }
+
+void dot_init() { // thread safe: first caller probes AVX, others wait
+    static once_t init;
+    once(&init, dot_init_once);
 }
 
 void dot_test() {
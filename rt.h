@@ -32,6 +32,30 @@ int      memmap_resource(const char* label, void* *data, int64_t *bytes);
 void*    load_dl(const char* pathname); // dlopen | LoadLibrary
 void*    find_symbol(void* dl, const char* symbol); // dlsym | GetProcAddress
 void     sleep(double seconds);
+uint32_t process_id();
+uint32_t thread_id();
+// replaces existing file "to" with "from" in single step (same volume)
+bool     file_replace(const char* from, const char* to);
+
+typedef struct thread_s* thread_t;
+
+thread_t thread_start(void (*func)(void* p), void* p);
+void     thread_join(thread_t t); // waits for thread to exit and disposes it
+
+typedef struct mutex_s { void* p; } mutex_t; // zero initialized, not recursive
+
+void     mutex_lock(mutex_t* m);
+void     mutex_unlock(mutex_t* m);
+
+typedef struct cond_s { void* p; } cond_t; // zero initialized
+
+void     cond_wait(cond_t* c, mutex_t* m); // "m" locked, spurious wakeups
+void     cond_signal(cond_t* c);    // wakes one waiter
+void     cond_broadcast(cond_t* c); // wakes all waiters
+
+typedef struct once_s { void* p; } once_t; // zero initialized
+
+void     once(once_t* o, void (*func)(void)); // func() exactly once
 
 #if defined(__GNUC__) || defined(__clang__)
 #define attribute_packed __attribute__((packed))
@@ -135,6 +159,23 @@ void*    __stdcall LoadResource(void* module, void* res);
 void*    __stdcall LockResource(void* res);
 void*    __stdcall LoadLibraryA(const char* pathname);
 void*    __stdcall GetProcAddress(void* module, const char* pathname);
+void*    __stdcall CreateThread(void* security, size_t stack_size,
+                    uint32_t (__stdcall *start)(void* p), void* p,
+                    uint32_t flags, uint32_t* thread_id);
+uint32_t __stdcall WaitForSingleObject(void* handle, uint32_t milliseconds);
+int32_t  __stdcall CloseHandle(void* handle);
+uint32_t __stdcall GetCurrentProcessId(void);
+uint32_t __stdcall GetCurrentThreadId(void);
+int32_t  __stdcall MoveFileExA(const char* from, const char* to, uint32_t flags);
+void     __stdcall AcquireSRWLockExclusive(void* lock);
+void     __stdcall ReleaseSRWLockExclusive(void* lock);
+int32_t  __stdcall SleepConditionVariableSRW(void* cv, void* lock,
+                    uint32_t milliseconds, uint32_t flags);
+void     __stdcall WakeConditionVariable(void* cv);
+void     __stdcall WakeAllConditionVariable(void* cv);
+int32_t  __stdcall InitOnceExecuteOnce(void* once,
+                    int32_t (__stdcall *func)(void* once, void* p, void** context),
+                    void* p, void** context);
 
 
 double seconds() { // since_boot
@@ -222,6 +263,73 @@ void sleep(double seconds) {
     NtDelayExecution(false, &delay);
 }
 
+uint32_t process_id() { return GetCurrentProcessId(); }
+
+uint32_t thread_id() { return GetCurrentThreadId(); }
+
+bool file_replace(const char* from, const char* to) {
+    enum { replace_existing = 0x1 }; // MOVEFILE_REPLACE_EXISTING
+    return MoveFileExA(from, to, replace_existing) != 0;
+}
+
+typedef struct thread_start_s {
+    void (*func)(void* p);
+    void* p;
+} thread_start_t;
+
+static uint32_t __stdcall thread_proc(void* p) {
+    thread_start_t ts = *(thread_start_t*)p;
+    free(p);
+    ts.func(ts.p);
+    return 0;
+}
+
+thread_t thread_start(void (*func)(void* p), void* p) {
+    thread_start_t* ts = (thread_start_t*)malloc(sizeof(thread_start_t));
+    fatal_if(ts == null);
+    ts->func = func;
+    ts->p = p;
+    void* t = CreateThread(null, 0, thread_proc, ts, 0, null);
+    fatal_if(t == null);
+    return (thread_t)t;
+}
+
+void thread_join(thread_t t) {
+    enum { infinite = 0xFFFFFFFF };
+    fatal_if(WaitForSingleObject(t, infinite) != 0); // WAIT_OBJECT_0
+    fatal_if(!CloseHandle(t));
+}
+
+void mutex_lock(mutex_t* m) { AcquireSRWLockExclusive(m); } // SRWLOCK
+
+void mutex_unlock(mutex_t* m) { ReleaseSRWLockExclusive(m); }
+
+void cond_wait(cond_t* c, mutex_t* m) { // CONDITION_VARIABLE
+    enum { infinite = 0xFFFFFFFF };
+    fatal_if(!SleepConditionVariableSRW(c, m, infinite, 0));
+}
+
+void cond_signal(cond_t* c) { WakeConditionVariable(c); }
+
+void cond_broadcast(cond_t* c) { WakeAllConditionVariable(c); }
+
+static int32_t __stdcall once_proc(void* o, void* p, void** context) {
+    (void)o; (void)context;
+    ((void (*)(void))p)();
+    return true;
+}
+
+void once(once_t* o, void (*func)(void)) { // INIT_ONCE
+    fatal_if(!InitOnceExecuteOnce(o, once_proc, (void*)func, null));
+}
+
+/* POSIX:
+#include <pthread.h>
+pthread_create(&thread, null, func, p) and pthread_join(thread, null)
+pthread_mutex_lock()/pthread_mutex_unlock() and pthread_once()
+pthread_cond_wait()/pthread_cond_signal()/pthread_cond_broadcast()
+*/
+
 /* POSIX:
 #include <time.h>
 void sleep(double seconds) {
@@ -1,6 +1,7 @@
 #include "rt.h"
 #include "blast.h"
 #include "dot.h"
+#include "dispatch.h"
 
 // TODO: test 1..16 all types, test permutations of offset and shift, test limited max_items = 4, max_groups = 2, test huge, test performance
 
@@ -155,6 +156,959 @@ static void test_performance(blast_t* b, const int32_t n) {
     assert(fabs(dot - sum) <= FLT_EPSILON, "dot: %.7e != %.7e\n", dot, sum);
 }
 
+static void test_tune(blast_t* b) {
+    // tuned launch shapes must not change results
+    enum { n = 1024 * 1024, columns = 1024 };
+    // existing tuning file is moved aside and restored at the end
+    char pn[countof(b->tuning.pathname)];
+    char aside[countof(pn) + 8];
+    strcpy(pn, b->tuning.pathname);
+    snprintf(aside, countof(aside), "%s.test", pn);
+    const bool moved = pn[0] != 0 && rename(pn, aside) == 0;
+    double time = seconds();
+    blast.tune(b, n);
+    time = seconds() - time;
+    traceln("tune: %.3f (sec) previously loaded shapes: %lld",
+            time, b->tuning.loaded);
+    if (pn[0] != 0) { // .init() must load exactly what .tune() saved
+        static blast_tuning_t tuned; // static: large for the stack
+        tuned = b->tuning;
+        ocl_context_t* c = b->c;
+        blast.fini(b);
+        blast.init(b, c);
+        fatal_if(memcmp(tuned.shape, b->tuning.shape, sizeof(tuned.shape)) != 0,
+                 "%s does not round trip", pn);
+        remove(pn);
+        if (moved) { rename(aside, pn); }
+    }
+    traceln("fp32 bucket: dot items x groups/unit, gemv items x groups/unit");
+    for (int k = 10; k <= 20; k++) {
+        const blast_shape_t* s = b->tuning.shape[blast_tune_dot][blast_fpp32];
+        const blast_shape_t* g = b->tuning.shape[blast_tune_gemv][blast_fpp32];
+        traceln("2^%d: %4d x %2d, %4d x %2d", k, s[k].items, s[k].groups,
+                g[k].items, g[k].groups);
+    }
+    test_dot_t td = test_dot_alloc(b, blast_fpp32, n, n);
+    test_dot_map(&td);
+    fp32_t* x = (fp32_t*)td.a0;
+    fp32_t* y = (fp32_t*)td.a1;
+    for (int64_t i = 0; i < n; i++) {
+        x[i] = (fp32_t)(i % 4);
+        y[i] = 1.0f;
+    }
+    test_dot_unmap(&td);
+    blast_memory_t r = blast.allocate(b, blast_access_read,
+                                      n / columns * sizeof(fp32_t));
+    for (int64_t i = 1024; i <= n; i *= 2) {
+        fp64_t dot = b->dot[blast_fpp32](&td.v0, 0, 1, &td.v1, 0, 1, i);
+        fp64_t expected = (i / 4) * 6.0;
+        fatal_if(dot != expected, "dot: %.7e != %.7e", dot, expected);
+        const int64_t m = i / columns;
+        b->gemv[blast_fpp32](&td.v0, 0, columns, &td.v1, 0, 1, &r, m, columns);
+        fp32_t* z = (fp32_t*)blast.map(&r, blast_access_read, 0,
+                                       m * sizeof(fp32_t));
+        for (int64_t j = 0; j < m; j++) {
+            fatal_if(z[j] != columns / 4 * 6.0f, "r[%lld]: %.7e", j, z[j]);
+        }
+        blast.unmap(&r);
+    }
+    blast.deallocate(&r);
+    test_dot_free(&td);
+}
+
+static void test_dot_scaling(blast_t* b) {
+    // single NDRange launch shape for 1M..128M elements
+    enum { n = 128 * 1024 * 1024 };
+    const int64_t bytes = n * sizeof(fp32_t);
+    if (ocl.devices[b->c->ix].global_memory < 4 * bytes) { return; }
+    test_dot_t td = test_dot_alloc(b, blast_fpp32, n, n);
+    test_dot_map(&td);
+    fp32_t* x = (fp32_t*)td.a0;
+    fp32_t* y = (fp32_t*)td.a1;
+    for (int64_t i = 0; i < n; i++) {
+        x[i] = 1.0f;
+        y[i] = i % 2 == 0 ? 0.5f : 0.25f;
+    }
+    test_dot_unmap(&td);
+    traceln("       n, groups, items, per_item, launches, time (ms)");
+    for (int64_t i = 1024 * 1024; i <= n; i *= 2) {
+        double time = seconds();
+        fp64_t dot = b->dot[blast_fpp32](&td.v0, 0, 1, &td.v1, 0, 1, i);
+        time = seconds() - time;
+        const blast_launch_t* l = &b->launch;
+        traceln("%9lld, %6lld, %5lld, %8lld, %8lld, %8.3f", i,
+            l->groups, l->items, l->per_item, l->launches, time * MSEC_IN_SEC);
+        fp64_t expected = (i / 2) * 0.5 + (i / 2) * 0.25;
+        fatal_if(fabs(dot - expected) > expected * 1e-5, "dot: %.7e != %.7e",
+                 dot, expected);
+        fatal_if(l->groups * l->items * l->per_item < i || l->launches > 2);
+    }
+    test_dot_free(&td);
+}
+
+static void test_dot_async(blast_t* b) {
+    // many dots in flight without host round trips, compared to sync dot()
+    enum { n = 1024 * 1024, k = 64 };
+    test_dot_t td = test_dot_alloc(b, blast_fpp32, n, n);
+    test_dot_map(&td);
+    fp32_t* x = (fp32_t*)td.a0;
+    fp32_t* y = (fp32_t*)td.a1;
+    for (int64_t i = 0; i < n; i++) {
+        x[i] = (fp32_t)(i % 16);
+        y[i] = 1.0f / 16;
+    }
+    test_dot_unmap(&td);
+    static blast_future_t f[k];
+    double async = seconds();
+    for (int i = 0; i < k; i++) {
+        const int64_t ne = n / k * (i + 1);
+        // every other dot depends on completion of previous one:
+        const blast_future_t* after = i % 2 == 1 ? &f[i - 1] : null;
+        f[i] = b->dot_async[blast_fpp32](&td.v0, 0, 1, &td.v1, 0, 1, ne, after);
+    }
+    fp64_t sum[k];
+    for (int i = 0; i < k; i++) { sum[i] = blast.wait(&f[i]); }
+    async = seconds() - async;
+    double sync = seconds();
+    for (int i = 0; i < k; i++) {
+        const int64_t ne = n / k * (i + 1);
+        fp64_t dot = b->dot[blast_fpp32](&td.v0, 0, 1, &td.v1, 0, 1, ne);
+        fatal_if(dot != sum[i], "dot: %.7e != %.7e", dot, sum[i]);
+    }
+    sync = seconds() - sync;
+    traceln("%d dots: async %.3f sync %.3f (ms)", k,
+            async * MSEC_IN_SEC, sync * MSEC_IN_SEC);
+    test_dot_free(&td);
+}
+
+static void test_wrap(blast_t* b) {
+    // host memory used in place: map() returns the wrapped address
+    enum { n = 64 * 1024, page = 4096 };
+    const int64_t bytes = n * sizeof(fp32_t);
+    fp32_t* x = (fp32_t*)_aligned_malloc(bytes, page);
+    fp32_t* y = (fp32_t*)_aligned_malloc(bytes, page);
+    fatal_if(x == null || y == null);
+    for (int64_t i = 0; i < n; i++) {
+        x[i] = (fp32_t)(i % 8);
+        y[i] = 0.5f;
+    }
+    blast_memory_t v0 = blast.wrap(b, blast_access_rw, x, bytes);
+    blast_memory_t v1 = blast.wrap(b, blast_access_read, y, bytes);
+    fp64_t dot = b->dot[blast_fpp32](&v0, 0, 1, &v1, 0, 1, n);
+    fatal_if(dot != n / 8 * 14.0, "dot: %.7e", dot);
+    fp32_t* a = (fp32_t*)blast.map(&v0, blast_access_write, 0, bytes);
+    fatal_if(a != x, "map: %p != wrapped %p", a, x);
+    for (int64_t i = 0; i < n; i++) { a[i] = 2.0f; }
+    blast.unmap(&v0);
+    dot = b->dot[blast_fpp32](&v0, 0, 1, &v1, 0, 1, n);
+    fatal_if(dot != n, "dot: %.7e", dot);
+    blast.deallocate(&v1);
+    blast.deallocate(&v0);
+    _aligned_free(y);
+    _aligned_free(x);
+}
+
+static void test_view(blast_t* b) {
+    // tensors packed in a single arena at aligned (views, compact kernels)
+    // and unaligned (offset + stride kernels) offsets
+    enum { k = 1000, tensors = 4 };
+    const int64_t align = ocl.devices[b->c->ix].base_align / sizeof(fp32_t);
+    const int64_t stride = (k + align - 1) / align * align + align;
+    const int64_t bytes = stride * tensors * sizeof(fp32_t);
+    blast_memory_t arena = blast.allocate(b, blast_access_rw, bytes);
+    fp32_t* a = (fp32_t*)blast.map(&arena, blast_access_write, 0, bytes);
+    for (int64_t i = 0; i < stride * tensors; i++) {
+        a[i] = (fp32_t)(i % 5);
+    }
+    fp64_t expected[tensors][2] = {0}; // [i][0] aligned, [i][1] offset by 1
+    for (int t = 0; t < tensors; t++) {
+        for (int u = 0; u < 2; u++) {
+            for (int64_t i = 0; i < k; i++) {
+                expected[t][u] += a[t * stride + u + i] * a[i];
+            }
+        }
+    }
+    blast.unmap(&arena);
+    for (int t = 0; t < tensors; t++) {
+        for (int u = 0; u < 2; u++) {
+            const int64_t o = t * stride + u;
+            fp64_t dot = b->dot[blast_fpp32](&arena, o, 1, &arena, 0, 1, k);
+            fatal_if(dot != expected[t][u], "dot: %.7e != %.7e",
+                     dot, expected[t][u]);
+        }
+        const int64_t offset = t * stride * sizeof(fp32_t);
+        blast_memory_t v = blast.view(&arena, offset, k * sizeof(fp32_t));
+        fp32_t* x = (fp32_t*)blast.map(&v, blast_access_read, 0, v.s);
+        for (int64_t i = 0; i < k; i++) {
+            fatal_if(x[i] != (fp32_t)((t * stride + i) % 5));
+        }
+        blast.unmap(&v);
+        fp64_t dot = b->dot[blast_fpp32](&v, 0, 1, &arena, 0, 1, k);
+        fatal_if(dot != expected[t][0], "dot: %.7e != %.7e",
+                 dot, expected[t][0]);
+        if (align < k) { // aligned offset inside the view: view of a view
+            const int64_t n = k - align;
+            fp64_t e = 0;
+            for (int64_t i = 0; i < n; i++) {
+                e += (fp64_t)((t * stride + align + i) % 5) * (i % 5);
+            }
+            dot = b->dot[blast_fpp32](&v, align, 1, &arena, 0, 1, n);
+            fatal_if(dot != e, "dot: %.7e != %.7e", dot, e);
+            blast_future_t f = b->dot_async[blast_fpp32](&v, align, 1,
+                &arena, 0, 1, n, null);
+            dot = blast.wait(&f);
+            fatal_if(dot != e, "dot_async: %.7e != %.7e", dot, e);
+        }
+        blast.deallocate(&v);
+    }
+    blast.deallocate(&arena);
+}
+
+static void test_svm(blast_t* b) {
+    // fine grained SVM: same address for host and kernels, no map/unmap
+    if ((ocl.devices[b->c->ix].svm & ocl_svm_fine_grain_buffer) == 0) {
+        return;
+    }
+    enum { n = 64 * 1024 };
+    const int64_t bytes = n * sizeof(fp32_t);
+    blast_memory_t v0 = blast.allocate_svm(b, blast_access_rw, bytes);
+    blast_memory_t v1 = blast.allocate_svm(b, blast_access_rw, bytes);
+    fp32_t* x = (fp32_t*)blast.map(&v0, blast_access_write, 0, bytes);
+    fp32_t* y = (fp32_t*)blast.map(&v1, blast_access_write, 0, bytes);
+    fatal_if(x != v0.h || y != v1.h);
+    for (int64_t i = 0; i < n; i++) {
+        x[i] = (fp32_t)(i % 8);
+        y[i] = 0.5f;
+    }
+    fp64_t dot = b->dot[blast_fpp32](&v0, 0, 1, &v1, 0, 1, n);
+    fatal_if(dot != n / 8 * 14.0, "dot: %.7e", dot);
+    // host writes between operations without remapping
+    for (int64_t i = 0; i < n; i++) { x[i] = 2.0f; }
+    dot = b->dot[blast_fpp32](&v0, 0, 1, &v1, 0, 1, n);
+    fatal_if(dot != n, "dot: %.7e", dot);
+    // unaligned offsets are plain addresses inside SVM
+    dot = b->dot[blast_fpp32](&v0, 3, 1, &v1, 5, 1, n - 5);
+    fatal_if(dot != n - 5, "dot: %.7e", dot);
+    blast.unmap(&v1);
+    blast.unmap(&v0);
+    blast.deallocate(&v1);
+    blast.deallocate(&v0);
+}
+
+static void test_graph(blast_t* b) {
+    // r1 = mx * v, r2 = mx * r1 recorded once and replayed per "step"
+    enum { n = 33 };
+    const int64_t bytes = n * sizeof(fp32_t);
+    blast_memory_t mx = blast.allocate(b, blast_access_write, n * bytes);
+    blast_memory_t v  = blast.allocate(b, blast_access_write, bytes);
+    blast_memory_t r1 = blast.allocate(b, blast_access_rw, bytes);
+    blast_memory_t r2 = blast.allocate(b, blast_access_rw, bytes);
+    fp32_t a[n][n];
+    fp32_t* m = (fp32_t*)blast.map(&mx, blast_access_write, 0, n * bytes);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            a[i][j] = (fp32_t)((i + j) % 3 - 1);
+            m[i * n + j] = a[i][j];
+        }
+    }
+    blast.unmap(&mx);
+    ocl_graph_t g;
+    ocl.record(b->c, &g);
+    b->gemv[blast_fpp32](&mx, 0, n, &v,  0, 1, &r1, n, n);
+    b->gemv[blast_fpp32](&mx, 0, n, &r1, 0, 1, &r2, n, n);
+    ocl.end_record(&g);
+    fatal_if(g.count < 2, "count: %d", g.count);
+    for (int step = 0; step < 3; step++) {
+        fp32_t x[n], y[n], z[n];
+        fp32_t* p = (fp32_t*)blast.map(&v, blast_access_write, 0, bytes);
+        for (int j = 0; j < n; j++) { x[j] = (fp32_t)((j + step) % 4); }
+        memcpy(p, x, bytes);
+        blast.unmap(&v);
+        ocl_event_t e = ocl.replay(&g);
+        ocl.wait(&e, 1);
+        ocl.release_event(e);
+        for (int i = 0; i < n; i++) {
+            y[i] = 0;
+            for (int j = 0; j < n; j++) { y[i] += a[i][j] * x[j]; }
+        }
+        for (int i = 0; i < n; i++) {
+            z[i] = 0;
+            for (int j = 0; j < n; j++) { z[i] += a[i][j] * y[j]; }
+        }
+        fp32_t* q = (fp32_t*)blast.map(&r2, blast_access_read, 0, bytes);
+        for (int i = 0; i < n; i++) {
+            fatal_if(q[i] != z[i], "step: %d [%d] %.7e != %.7e",
+                     step, i, q[i], z[i]);
+        }
+        blast.unmap(&r2);
+    }
+    ocl.discard(&g);
+    blast.deallocate(&r2);
+    blast.deallocate(&r1);
+    blast.deallocate(&v);
+    blast.deallocate(&mx);
+}
+
+static void test_graph_ops(blast_t* b) {
+    // gemm c = a * a and dot_async(x, y) long enough for sum_reduce():
+    // scratch and result of recorded dot belong to the graph, pooled
+    // scratch used in between replays must not disturb them
+    enum { n = 9, k = 100003 };
+    const int64_t mb = n * n * sizeof(fp32_t);
+    const int64_t vb = k * sizeof(fp32_t);
+    blast_memory_t ma = blast.allocate(b, blast_access_write, mb);
+    blast_memory_t mc = blast.allocate(b, blast_access_rw, mb);
+    blast_memory_t x  = blast.allocate(b, blast_access_write, vb);
+    blast_memory_t y  = blast.allocate(b, blast_access_write, vb);
+    ocl_graph_t g;
+    ocl.record(b->c, &g);
+    b->gemm[blast_fpp32](&ma, 0, n, &ma, 0, n, &mc, 0, n, n, n, n);
+    blast_future_t f = b->dot_async[blast_fpp32](&x, 0, 1, &y, 0, 1, k, null);
+    ocl.end_record(&g);
+    fatal_if(g.count < 2, "count: %d", g.count);
+    for (int step = 0; step < 3; step++) {
+        static fp32_t a[n * n];
+        fp32_t* p = (fp32_t*)blast.map(&ma, blast_access_write, 0, mb);
+        for (int i = 0; i < n * n; i++) { a[i] = (fp32_t)((i + step) % 5 - 2); }
+        memcpy(p, a, mb);
+        blast.unmap(&ma);
+        fp32_t* px = (fp32_t*)blast.map(&x, blast_access_write, 0, vb);
+        fp32_t* py = (fp32_t*)blast.map(&y, blast_access_write, 0, vb);
+        fp64_t expected = 0;
+        for (int i = 0; i < k; i++) {
+            px[i] = (fp32_t)((i + step) % 3);
+            py[i] = (fp32_t)(i % 2);
+            expected += px[i] * py[i];
+        }
+        blast.unmap(&y);
+        blast.unmap(&x);
+        blast_memory_t s = blast.scratch(b, 64 * 1024);
+        memset(blast.map(&s, blast_access_write, 0, s.s), 0xFF, s.s);
+        blast.unmap(&s);
+        blast.release(&s);
+        ocl_event_t e = ocl.replay(&g);
+        ocl.wait(&e, 1);
+        ocl.release_event(e);
+        const fp64_t dot = blast.wait(&f);
+        fatal_if(dot != expected, "step: %d dot: %.7e != %.7e",
+                 step, dot, expected);
+        fp32_t* q = (fp32_t*)blast.map(&mc, blast_access_read, 0, mb);
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                fp32_t c = 0;
+                for (int l = 0; l < n; l++) {
+                    c += a[i * n + l] * a[l * n + j];
+                }
+                fatal_if(q[i * n + j] != c, "step: %d [%d][%d] %.7e != %.7e",
+                         step, i, j, q[i * n + j], c);
+            }
+        }
+        blast.unmap(&mc);
+    }
+    ocl.discard(&g); // releases scratch and result memory of "f"
+    blast.deallocate(&y);
+    blast.deallocate(&x);
+    blast.deallocate(&mc);
+    blast.deallocate(&ma);
+}
+
+typedef struct test_thread_s {
+    ocl_context_t c; // ocl.fork() of the test context
+    blast_t b;       // blast.clone() on "c"
+    blast_memory_t mx; // shared matrix [m][n]
+    int id;
+    int64_t m;
+    int64_t n;
+} test_thread_t;
+
+static void test_thread(void* p) {
+    test_thread_t* t = (test_thread_t*)p;
+    const int64_t m = t->m, n = t->n;
+    blast_memory_t mx = blast.share(&t->mx, &t->b);
+    blast_memory_t v = blast.allocate(&t->b, blast_access_write,
+                                      n * sizeof(fp32_t));
+    blast_memory_t r = blast.allocate(&t->b, blast_access_rw,
+                                      m * sizeof(fp32_t));
+    for (int step = 0; step < 16; step++) {
+        const fp32_t k = (fp32_t)(t->id + step);
+        fp32_t* x = (fp32_t*)blast.map(&v, blast_access_write, 0, v.s);
+        for (int64_t j = 0; j < n; j++) { x[j] = k; }
+        blast.unmap(&v);
+        t->b.gemv[blast_fpp32](&mx, 0, n, &v, 0, 1, &r, m, n);
+        // row i of mx is all (i % 3): r[i] = (i % 3) * k * n
+        fp32_t* y = (fp32_t*)blast.map(&r, blast_access_read, 0, r.s);
+        for (int64_t i = 0; i < m; i++) {
+            const fp32_t e = (fp32_t)(i % 3) * k * (fp32_t)n;
+            fatal_if(y[i] != e, "thread: %d r[%lld]: %.7e != %.7e",
+                     t->id, i, y[i], e);
+        }
+        blast.unmap(&r);
+        fp64_t dot = t->b.dot[blast_fpp32](&v, 0, 1, &v, 0, 1, n);
+        fatal_if(dot != (fp64_t)k * k * n, "thread: %d dot: %.7e", t->id, dot);
+    }
+    blast.deallocate(&r);
+    blast.deallocate(&v);
+}
+
+static void test_threads(blast_t* b) {
+    // concurrent submitters: forked contexts and cloned blast_t share
+    // OpenCL context and matrix memory
+    enum { threads = 4, m = 67, n = 129 };
+    blast_memory_t mx = blast.allocate(b, blast_access_write,
+                                       m * n * sizeof(fp32_t));
+    fp32_t* a = (fp32_t*)blast.map(&mx, blast_access_write, 0, mx.s);
+    for (int64_t i = 0; i < m * n; i++) { a[i] = (fp32_t)(i / n % 3); }
+    blast.unmap(&mx);
+    static test_thread_t tt[threads];
+    thread_t th[threads];
+    for (int i = 0; i < threads; i++) {
+        test_thread_t* t = &tt[i];
+        t->c = ocl.fork(b->c);
+        blast.clone(&t->b, b, &t->c);
+        t->mx = mx;
+        t->id = i;
+        t->m = m;
+        t->n = n;
+    }
+    for (int i = 0; i < threads; i++) {
+        th[i] = thread_start(test_thread, &tt[i]);
+    }
+    for (int i = 0; i < threads; i++) { thread_join(th[i]); }
+    for (int i = 0; i < threads; i++) {
+        blast.fini(&tt[i].b);
+        ocl.close(&tt[i].c);
+    }
+    blast.deallocate(&mx);
+}
+
+static void test_pool(blast_t* b) {
+    // repeated dot() calls are served from the scratch pool
+    enum { n = 64 * 1024, k = 16 };
+    test_dot_t td = test_dot_alloc(b, blast_fpp32, n, n);
+    test_dot_map(&td);
+    for (int64_t i = 0; i < n; i++) {
+        ((fp32_t*)td.a0)[i] = 1.0f;
+        ((fp32_t*)td.a1)[i] = 2.0f;
+    }
+    test_dot_unmap(&td);
+    fatal_if(b->dot[blast_fpp32](&td.v0, 0, 1, &td.v1, 0, 1, n) != 2.0 * n);
+    const blast_pool_t* p = &b->pool;
+    const int64_t misses = p->misses;
+    const int64_t hits = p->hits;
+    double time = seconds();
+    for (int i = 0; i < k; i++) {
+        fp64_t dot = b->dot[blast_fpp32](&td.v0, 0, 1, &td.v1, 0, 1, n);
+        fatal_if(dot != 2.0 * n, "dot: %.7e", dot);
+    }
+    time = seconds() - time;
+    fatal_if(p->misses != misses || p->hits <= hits,
+             "misses: %lld hits: %lld", p->misses, p->hits);
+    traceln("%d x dot[%d] %.3f (ms) pool hits: %lld misses: %lld bytes: %lld",
+            k, n, time * MSEC_IN_SEC, p->hits, p->misses, p->bytes);
+    blast.trim(b, 0);
+    fatal_if(p->bytes != 0);
+    for (int i = 0; i < blast_pool_classes; i++) { fatal_if(p->count[i] != 0); }
+    test_dot_free(&td);
+}
+
+static void test_dot_batched(blast_t* b) {
+    // attention-score shape: one query against "count" keys of "n" elements
+    enum { n = 64, count = 1024 };
+    blast_memory_t q = blast.allocate(b, blast_access_write, n * sizeof(fp32_t));
+    blast_memory_t k = blast.allocate(b, blast_access_write,
+                                      n * count * sizeof(fp32_t));
+    blast_memory_t r = blast.allocate(b, blast_access_read, count * sizeof(fp32_t));
+    fp32_t* x = (fp32_t*)blast.map(&q, blast_access_write, 0, n * sizeof(fp32_t));
+    fp32_t* y = (fp32_t*)blast.map(&k, blast_access_write, 0,
+                                   n * count * sizeof(fp32_t));
+    static fp32_t expected[count];
+    for (int i = 0; i < n; i++) { x[i] = (fp32_t)(i % 4); }
+    for (int j = 0; j < count; j++) {
+        expected[j] = 0;
+        for (int i = 0; i < n; i++) {
+            y[j * n + i] = (fp32_t)((i + j) % 8);
+            expected[j] += x[i] * y[j * n + i];
+        }
+    }
+    blast.unmap(&k);
+    blast.unmap(&q);
+    double batched = seconds();
+    blast_future_t f = b->dot_batched[blast_fpp32](&q, 0, 1, 0,
+        &k, 0, 1, n, &r, 0, n, count, null);
+    blast.wait(&f);
+    batched = seconds() - batched;
+    double single = seconds();
+    for (int j = 0; j < count; j++) {
+        fp64_t dot = b->dot[blast_fpp32](&q, 0, 1, &k, j * n, 1, n);
+        fatal_if(dot != expected[j], "dot[%d]: %.7e != %.7e", j, dot, expected[j]);
+    }
+    single = seconds() - single;
+    fp32_t* z = (fp32_t*)blast.map(&r, blast_access_read, 0, count * sizeof(fp32_t));
+    for (int j = 0; j < count; j++) {
+        fatal_if(z[j] != expected[j], "r[%d]: %.7e != %.7e", j, z[j], expected[j]);
+    }
+    blast.unmap(&r);
+    traceln("%d x dot[%d]: batched %.3f single %.3f (ms)", count, n,
+            batched * MSEC_IN_SEC, single * MSEC_IN_SEC);
+    blast.deallocate(&r);
+    blast.deallocate(&k);
+    blast.deallocate(&q);
+}
+
+static void test_gemv_store(void* a, int fpp, int64_t i, int32_t v) {
+    if (fpp == blast_fpp16) {
+        ((fp16_t*)a)[i] = fp32to16((fp32_t)v);
+    } else if (fpp == blast_fpp32) {
+        ((fp32_t*)a)[i] = (fp32_t)v;
+    } else {
+        ((fp64_t*)a)[i] = (fp64_t)v;
+    }
+}
+
+static fp64_t test_gemv_load(void* a, int fpp, int64_t i) {
+    if (fpp == blast_fpp16) {
+        return fp16to32(((fp16_t*)a)[i]);
+    } else if (fpp == blast_fpp32) {
+        return ((fp32_t*)a)[i];
+    } else {
+        return ((fp64_t*)a)[i];
+    }
+}
+
+static void test_gemv_mn(blast_t* b, bool mixed, int fpp, int vfpp, int rfpp,
+        int64_t m, int64_t n, int64_t om, int64_t sm, int64_t ov, int64_t sv) {
+    // mixed: gemv_mixed() with fp16 matrix, otherwise fpp == vfpp == rfpp
+    // small integers are exact in all precisions (incl. fp16 for n < 64)
+    const int64_t bytes_m = (om + m * sm) * sizes[fpp];
+    const int64_t bytes_v = (ov + n * sv) * sizes[vfpp];
+    const int64_t bytes_r = m * sizes[rfpp];
+    blast_memory_t mx = blast.allocate(b, blast_access_write, bytes_m);
+    blast_memory_t v  = blast.allocate(b, blast_access_write, bytes_v);
+    blast_memory_t r  = blast.allocate(b, blast_access_read,  bytes_r);
+    void* a = blast.map(&mx, blast_access_write, 0, bytes_m);
+    for (int64_t i = 0; i < om + m * sm; i++) {
+        test_gemv_store(a, fpp, i, -1); // garbage outside of the matrix
+    }
+    for (int64_t i = 0; i < m; i++) {
+        for (int64_t j = 0; j < n; j++) {
+            test_gemv_store(a, fpp, om + i * sm + j, (int32_t)((i + j) % 4));
+        }
+    }
+    blast.unmap(&mx);
+    a = blast.map(&v, blast_access_write, 0, bytes_v);
+    for (int64_t i = 0; i < ov + n * sv; i++) { test_gemv_store(a, vfpp, i, -1); }
+    for (int64_t j = 0; j < n; j++) {
+        test_gemv_store(a, vfpp, ov + j * sv, (int32_t)(j % 3));
+    }
+    blast.unmap(&v);
+    if (mixed) {
+        b->gemv_mixed(&mx, om, sm, &v, ov, sv, vfpp, &r, rfpp, m, n);
+    } else {
+        b->gemv[fpp](&mx, om, sm, &v, ov, sv, &r, m, n);
+    }
+    a = blast.map(&r, blast_access_read, 0, bytes_r);
+    for (int64_t i = 0; i < m; i++) {
+        fp64_t expected = 0;
+        for (int64_t j = 0; j < n; j++) {
+            expected += (fp64_t)((i + j) % 4) * (fp64_t)(j % 3);
+        }
+        fp64_t result = test_gemv_load(a, rfpp, i);
+        fatal_if(result != expected, "%s%s gemv[%lldx%lld] [o:%lld s:%lld] "
+                 "[o:%lld s:%lld] r[%lld]: %.7e != %.7e", blast_fpp_names[fpp],
+                 mixed ? " mixed" : "", m, n, om, sm, ov, sv, i,
+                 result, expected);
+    }
+    blast.unmap(&r);
+    blast.deallocate(&r);
+    blast.deallocate(&v);
+    blast.deallocate(&mx);
+}
+
+static void test_gemv(blast_t* b) {
+    for (int fpp = blast_fpp16; fpp <= blast_fpp64; fpp++) {
+        if (b->gemv[fpp] != null) {
+            for (int m = 1; m < 10; m++) {
+                for (int n = 1; n < 12; n++) {
+                    test_gemv_mn(b, false, fpp, fpp, fpp, m, n, 0, n, 0, 1);
+                    test_gemv_mn(b, false, fpp, fpp, fpp, m, n, 3, n + 2, 1, 2);
+                }
+            }
+            test_gemv_mn(b, false, fpp, fpp, fpp, 33, 61, 5, 67, 3, 3);
+        }
+    }
+}
+
+static void test_gemv_mixed(blast_t* b) {
+    // fp16 matrix x {fp16, fp32} vector -> {fp16, fp32} result
+    for (int vfpp = blast_fpp16; vfpp <= blast_fpp32; vfpp++) {
+        for (int rfpp = blast_fpp16; rfpp <= blast_fpp32; rfpp++) {
+            for (int m = 1; m < 6; m++) {
+                for (int n = 1; n < 10; n++) {
+                    test_gemv_mn(b, true, blast_fpp16, vfpp, rfpp,
+                                 m, n, 0, n, 0, 1);
+                    test_gemv_mn(b, true, blast_fpp16, vfpp, rfpp,
+                                 m, n, 1, n + 1, 2, 2);
+                }
+            }
+            test_gemv_mn(b, true, blast_fpp16, vfpp, rfpp, 33, 61, 5, 67, 3, 3);
+        }
+    }
+}
+
+static void test_gemv_q_mn(blast_t* b, int q, int64_t m, int64_t n) {
+    const int64_t bytes = blast.quantized_bytes(q, m, n);
+    fp32_t* x = (fp32_t*)malloc(m * n * sizeof(fp32_t));
+    fp32_t* y = (fp32_t*)malloc(m * n * sizeof(fp32_t));
+    fp32_t* z = (fp32_t*)malloc(m * sizeof(fp32_t));
+    fatal_if(x == null || y == null || z == null);
+    for (int64_t i = 0; i < m * n; i++) {
+        x[i] = (fp32_t)((int32_t)(random32(&seed) % 2001) - 1000) / 1000.0f;
+    }
+    blast_memory_t mx = blast.allocate(b, blast_access_write, bytes);
+    blast_memory_t v  = blast.allocate(b, blast_access_write, n * sizeof(fp32_t));
+    blast_memory_t r  = blast.allocate(b, blast_access_read,  m * sizeof(fp32_t));
+    void* packed = blast.map(&mx, blast_access_write, 0, bytes);
+    blast.quantize(q, x, m, n, packed);
+    blast.dequantize(q, packed, m, n, y);
+    // round trip error is at most half of quantization step (|x| <= 1)
+    // plus fp16_t rounding of the scale
+    const fp64_t step = q == blast_q8 ? 1.0 / 127 : 1.0 / 7;
+    for (int64_t i = 0; i < m * n; i++) {
+        fatal_if(fabs(x[i] - y[i]) > step / 2 * 1.01,
+                 "%s x[%lld]: %.7e dequantized: %.7e", blast_q_names[q],
+                 i, x[i], y[i]);
+    }
+    fp32_t* a = (fp32_t*)blast.map(&v, blast_access_write, 0, n * sizeof(fp32_t));
+    for (int64_t j = 0; j < n; j++) { a[j] = (fp32_t)(j % 5) - 2; }
+    blast.gemv_q_reference(q, packed, m, n, a, z);
+    blast.unmap(&v);
+    blast.unmap(&mx);
+    b->gemv_q[q](&mx, &v, 0, 1, &r, m, n);
+    fp32_t* c = (fp32_t*)blast.map(&r, blast_access_read, 0, m * sizeof(fp32_t));
+    for (int64_t i = 0; i < m; i++) {
+        fatal_if(fabs(c[i] - z[i]) > n * 8 * FLT_EPSILON,
+                 "%s gemv[%lldx%lld] r[%lld]: %.7e != %.7e", blast_q_names[q],
+                 m, n, i, c[i], z[i]);
+    }
+    blast.unmap(&r);
+    blast.deallocate(&r);
+    blast.deallocate(&v);
+    blast.deallocate(&mx);
+    free(z);
+    free(y);
+    free(x);
+}
+
+static void test_gemv_q(blast_t* b) {
+    for (int q = blast_q8; q <= blast_q4; q++) {
+        for (int m = 1; m < 10; m++) {
+            for (int k = 1; k <= 4; k++) {
+                test_gemv_q_mn(b, q, m, k * blast_q_block);
+            }
+        }
+        test_gemv_q_mn(b, q, 67, 33 * blast_q_block);
+    }
+}
+
+static void test_gemm_mnk(blast_t* b, bool mixed, int fpp,
+        int64_t m, int64_t n, int64_t k, int64_t o, int64_t ld) {
+    // mixed: gemm_mixed() fp16 a, b and fp32 c; ld is added to leading dims
+    const int fpp_c = mixed ? blast_fpp32 : fpp;
+    const int64_t lda = k + ld, ldb = n + ld, ldc = n + ld;
+    const int64_t bytes_a = (o + m * lda) * sizes[fpp];
+    const int64_t bytes_b = (o + k * ldb) * sizes[fpp];
+    const int64_t bytes_c = (o + m * ldc) * sizes[fpp_c];
+    blast_memory_t ma = blast.allocate(b, blast_access_write, bytes_a);
+    blast_memory_t mb = blast.allocate(b, blast_access_write, bytes_b);
+    blast_memory_t mc = blast.allocate(b, blast_access_rw, bytes_c);
+    void* a = blast.map(&ma, blast_access_write, 0, bytes_a);
+    for (int64_t i = 0; i < o + m * lda; i++) { test_gemv_store(a, fpp, i, -1); }
+    for (int64_t i = 0; i < m; i++) {
+        for (int64_t j = 0; j < k; j++) {
+            test_gemv_store(a, fpp, o + i * lda + j, (int32_t)((i + j) % 3));
+        }
+    }
+    blast.unmap(&ma);
+    a = blast.map(&mb, blast_access_write, 0, bytes_b);
+    for (int64_t i = 0; i < o + k * ldb; i++) { test_gemv_store(a, fpp, i, -1); }
+    for (int64_t i = 0; i < k; i++) {
+        for (int64_t j = 0; j < n; j++) {
+            test_gemv_store(a, fpp, o + i * ldb + j, (int32_t)((i * 2 + j) % 5) - 2);
+        }
+    }
+    blast.unmap(&mb);
+    a = blast.map(&mc, blast_access_write, 0, bytes_c);
+    for (int64_t i = 0; i < o + m * ldc; i++) { test_gemv_store(a, fpp_c, i, 7); }
+    blast.unmap(&mc);
+    if (mixed) {
+        b->gemm_mixed(&ma, o, lda, &mb, o, ldb, &mc, o, ldc, m, n, k);
+    } else {
+        b->gemm[fpp](&ma, o, lda, &mb, o, ldb, &mc, o, ldc, m, n, k);
+    }
+    a = blast.map(&mc, blast_access_read, 0, bytes_c);
+    for (int64_t i = 0; i < m; i++) {
+        for (int64_t j = 0; j < n; j++) {
+            fp64_t expected = 0;
+            for (int64_t x = 0; x < k; x++) {
+                expected += (fp64_t)((i + x) % 3) * (fp64_t)((x * 2 + j) % 5 - 2);
+            }
+            fp64_t result = test_gemv_load(a, fpp_c, o + i * ldc + j);
+            fatal_if(result != expected, "%s%s gemm[%lldx%lldx%lld] "
+                     "c[%lld][%lld]: %.7e != %.7e", blast_fpp_names[fpp],
+                     mixed ? " mixed" : "", m, n, k, i, j, result, expected);
+        }
+        // elements in between rows are not touched
+        for (int64_t j = n; j < ldc && i < m - 1; j++) {
+            fatal_if(test_gemv_load(a, fpp_c, o + i * ldc + j) != 7);
+        }
+    }
+    blast.unmap(&mc);
+    blast.deallocate(&mc);
+    blast.deallocate(&mb);
+    blast.deallocate(&ma);
+}
+
+static void test_gemm(blast_t* b) {
+    const blast_gemm_tile_t defaults = b->gemm_tile;
+    static const blast_gemm_tile_t tiles[] = {
+        {16, 64}, {4, 5}, {8, 16}, {3, 2}, {32, 64}
+    };
+    for (int t = 0; t < countof(tiles); t++) {
+        b->gemm_tile = tiles[t];
+        for (int fpp = blast_fpp16; fpp <= blast_fpp64; fpp++) {
+            if (b->gemm[fpp] != null) {
+                for (int m = 1; m < 6; m++) {
+                    test_gemm_mnk(b, false, fpp, m, m + 2, 7 - m, 0, 0);
+                    test_gemm_mnk(b, false, fpp, m, 3, m * 3, 2, 1);
+                }
+                test_gemm_mnk(b, false, fpp, 19, 23, 17, 3, 5);
+            }
+        }
+        test_gemm_mnk(b, true, blast_fpp16, 5, 7, 9, 1, 2);
+        test_gemm_mnk(b, true, blast_fpp16, 19, 23, 17, 3, 5);
+    }
+    b->gemm_tile = defaults;
+}
+
+// ndrange kernel counts visits of every global id (3D row major)
+
+static const char* test_ndrange_code =
+    "__kernel void ndrange(__global int* r, const int w, const int h) {\n"
+    "    const size_t i = (get_global_id(2) * h + get_global_id(1)) * w +\n"
+    "                     get_global_id(0);\n"
+    "    atomic_inc(&r[i]);\n"
+    "}\n";
+
+static void test_ndrange_range(blast_t* b, ocl_kernel_t k, ocl_range_t* r) {
+    size_t extent[3] = {1, 1, 1}; // offset + global
+    for (int i = 0; i < r->dims; i++) { extent[i] = r->offset[i] + r->global[i]; }
+    const int64_t count = (int64_t)(extent[0] * extent[1] * extent[2]);
+    const int64_t bytes = count * sizeof(int32_t);
+    blast_memory_t m = blast.allocate(b, blast_access_rw, bytes);
+    int32_t* a = (int32_t*)blast.map(&m, blast_access_write, 0, bytes);
+    memset(a, 0, (size_t)bytes);
+    blast.unmap(&m);
+    int32_t w = (int32_t)extent[0], h = (int32_t)extent[1];
+    ocl_arg_t args[] = {
+        {&m.h, sizeof(ocl_memory_t)},
+        {&w,   sizeof(int32_t)},
+        {&h,   sizeof(int32_t)}
+    };
+    ocl_event_t e = ocl.enqueue_ndrange_kernel(b->c, k, r,
+        countof(args), args, 0, null);
+    ocl.wait(&e, 1);
+    ocl.release_event(e);
+    a = (int32_t*)blast.map(&m, blast_access_read, 0, bytes);
+    for (int64_t z = 0; z < (int64_t)extent[2]; z++) {
+        for (int64_t y = 0; y < (int64_t)extent[1]; y++) {
+            for (int64_t x = 0; x < (int64_t)extent[0]; x++) {
+                const int64_t at[3] = {x, y, z};
+                bool inside = true;
+                for (int i = 0; i < r->dims; i++) {
+                    inside = inside && at[i] >= (int64_t)r->offset[i];
+                }
+                const int32_t v = a[(z * h + y) * w + x];
+                fatal_if(v != (inside ? 1 : 0), "[%lld,%lld,%lld]: %d",
+                         z, y, x, v);
+            }
+        }
+    }
+    blast.unmap(&m);
+    blast.deallocate(&m);
+}
+
+static void test_ndrange(blast_t* b) {
+    ocl_program_t p = ocl.compile_program(b->c, test_ndrange_code,
+        strlen(test_ndrange_code), null);
+    ocl_kernel_t k = ocl.create_kernel(p, "ndrange");
+    for (int dims = 1; dims <= 3; dims++) {
+        for (int g = 1; g <= 7; g += 3) {
+            for (int o = 0; o <= 2; o += 2) {
+                // automatic local sizes
+                ocl_range_t r = { .dims = dims };
+                for (int i = 0; i < dims; i++) {
+                    r.offset[i] = o;
+                    r.global[i] = g + i * 2;
+                }
+                test_ndrange_range(b, k, &r);
+                ocl.local_size(b->c, k, &r);
+                for (int i = 0; i < dims; i++) {
+                    fatal_if(r.local[i] < 1 || r.local[i] > r.global[i]);
+                }
+                // explicit local sizes that do not divide global sizes
+                for (int i = 0; i < dims; i++) { r.local[i] = 2; }
+                test_ndrange_range(b, k, &r);
+            }
+        }
+    }
+    ocl.release_kernel(k);
+    ocl.release_program(p);
+}
+
+static double test_kernel_time(blast_t* b, ocl_kernel_t k,
+        int64_t groups, int64_t items, int argc, ocl_arg_t argv[]) {
+    ocl_context_t* c = b->c;
+    c->ov->profiling_count = 0;
+    ocl_event_t e = ocl.enqueue_range_kernel(c, k, groups, items, argc, argv);
+    ocl_profiling_t* p = ocl.profile_add(c, e);
+    ocl.wait(&e, 1);
+    ocl.profile(p);
+    ocl.release_event(e);
+    return p->time;
+}
+
+static void test_gemv_performance(blast_t* b) {
+    // gemv is memory bound: compare GB/s with device copy bandwidth
+    enum { m = 4096, n = 4096 };
+    const ocl_device_t* d = &ocl.devices[b->c->ix];
+    const int64_t bytes = (int64_t)m * n * sizeof(fp32_t);
+    blast_memory_t mx = blast.allocate(b, blast_access_write, bytes);
+    blast_memory_t cp = blast.allocate(b, blast_access_read, bytes);
+    blast_memory_t v  = blast.allocate(b, blast_access_write, n * sizeof(fp32_t));
+    blast_memory_t r  = blast.allocate(b, blast_access_read,  m * sizeof(fp32_t));
+    fp32_t* x = (fp32_t*)blast.map(&mx, blast_access_write, 0, bytes);
+    for (int64_t i = 0; i < (int64_t)m * n; i++) { x[i] = (fp32_t)(i % 3); }
+    blast.unmap(&mx);
+    fp32_t* y = (fp32_t*)blast.map(&v, blast_access_write, 0, n * sizeof(fp32_t));
+    for (int64_t i = 0; i < n; i++) { y[i] = (fp32_t)(i % 2); }
+    blast.unmap(&v);
+    // first gemv() also creates fp32 kernels used directly below
+    b->gemv[blast_fpp32](&mx, 0, n, &v, 0, 1, &r, m, n);
+    double tiled = b->c->ov->profiling[0].time;
+    const blast_launch_t l = b->launch; // gemv_mixed() and gemv_q() overwrite
+    int32_t count = m * n;
+    ocl_arg_t copy_args[] = {
+        {&mx.h,  sizeof(ocl_memory_t)},
+        {&cp.h,  sizeof(ocl_memory_t)},
+        {&count, sizeof(int32_t)}
+    };
+    const int64_t items = d->max_items[0];
+    const int64_t groups = min(d->max_groups, d->compute_units * 4);
+    double copy = test_kernel_time(b, b->copy[blast_fpp32], groups, items,
+                                   countof(copy_args), copy_args);
+    int32_t zero = 0, one = 1, row_stride = n, nn = n;
+    ocl_arg_t naive_args[] = {
+        {&mx.h,       sizeof(ocl_memory_t)},
+        {&zero,       sizeof(int32_t)},
+        {&row_stride, sizeof(int32_t)},
+        {&one,        sizeof(int32_t)},
+        {&v.h,        sizeof(ocl_memory_t)},
+        {&zero,       sizeof(int32_t)},
+        {&one,        sizeof(int32_t)},
+        {&r.h,        sizeof(ocl_memory_t)},
+        {&nn,         sizeof(int32_t)}
+    };
+    const int64_t row_items = min(m, d->max_items[0]);
+    double naive = test_kernel_time(b, b->gemv_os[blast_fpp32],
+        m / row_items, row_items, countof(naive_args), naive_args);
+    fp32_t* z = (fp32_t*)blast.map(&r, blast_access_read, 0, m * sizeof(fp32_t));
+    for (int64_t i = 0; i < m; i++) {
+        fp64_t expected = 0;
+        for (int64_t j = 1; j < n; j += 2) { expected += (i * n + j) % 3; }
+        fatal_if(z[i] != expected, "r[%lld]: %.7e != %.7e", i, z[i], expected);
+    }
+    blast.unmap(&r);
+    // fp16 weights: half of the bytes read per row
+    blast_memory_t mh = blast.allocate(b, blast_access_write, bytes / 2);
+    fp16_t* h = (fp16_t*)blast.map(&mh, blast_access_write, 0, bytes / 2);
+    for (int64_t i = 0; i < (int64_t)m * n; i++) {
+        h[i] = fp32to16((fp32_t)(i % 3));
+    }
+    blast.unmap(&mh);
+    b->gemv_mixed(&mh, 0, n, &v, 0, 1, blast_fpp32, &r, blast_fpp32, m, n);
+    double mixed = b->c->ov->profiling[0].time;
+    blast.deallocate(&mh);
+    double quantized[2] = {0};
+    int64_t qbytes[2] = {0};
+    for (int q = blast_q8; q <= blast_q4; q++) {
+        qbytes[q] = blast.quantized_bytes(q, m, n);
+        blast_memory_t mq = blast.allocate(b, blast_access_write, qbytes[q]);
+        byte_t* pq = (byte_t*)blast.map(&mq, blast_access_write, 0, qbytes[q]);
+        for (int64_t i = 0; i < qbytes[q]; i++) { pq[i] = (byte_t)(i % 7); }
+        blast.unmap(&mq);
+        b->gemv_q[q](&mq, &v, 0, 1, &r, m, n);
+        quantized[q] = b->c->ov->profiling[0].time;
+        blast.deallocate(&mq);
+    }
+    const double gb = (double)(bytes + (n + m) * sizeof(fp32_t)) / 1e9;
+    traceln("gemv_fp32[%dx%d] groups: %lld items: %lld", m, n,
+            l.groups, l.items);
+    traceln("copy : %7.3f (ms) %7.3f GB/s", copy * MSEC_IN_SEC,
+            2 * bytes / 1e9 / copy);
+    traceln("naive: %7.3f (ms) %7.3f GB/s", naive * MSEC_IN_SEC, gb / naive);
+    traceln("tiled: %7.3f (ms) %7.3f GB/s %5.1f%% of copy bandwidth",
+            tiled * MSEC_IN_SEC, gb / tiled,
+            100.0 * (gb / tiled) / (2 * bytes / 1e9 / copy));
+    const double gb16 = (double)(bytes / 2 + (n + m) * sizeof(fp32_t)) / 1e9;
+    traceln("mixed: %7.3f (ms) %7.3f GB/s fp16 matrix x%.2f vs tiled fp32",
+            mixed * MSEC_IN_SEC, gb16 / mixed, tiled / mixed);
+    for (int q = blast_q8; q <= blast_q4; q++) {
+        const double gbq = (double)(qbytes[q] + (n + m) * sizeof(fp32_t)) / 1e9;
+        traceln("%s   : %7.3f (ms) %7.3f GB/s x%.2f vs tiled fp32",
+                blast_q_names[q], quantized[q] * MSEC_IN_SEC,
+                gbq / quantized[q], tiled / quantized[q]);
+    }
+    blast.deallocate(&r);
+    blast.deallocate(&v);
+    blast.deallocate(&cp);
+    blast.deallocate(&mx);
+}
+
+static void test_gemm_performance(blast_t* b) {
+    // GFlops reported by ocl_profiling_t counters (2 * m * n * k flops)
+    enum { n = 1024 };
+    const int64_t bytes = (int64_t)n * n * sizeof(fp32_t);
+    blast_memory_t ma = blast.allocate(b, blast_access_write, bytes);
+    blast_memory_t mb = blast.allocate(b, blast_access_write, bytes);
+    blast_memory_t mc = blast.allocate(b, blast_access_read,  bytes);
+    fp32_t* x = (fp32_t*)blast.map(&ma, blast_access_write, 0, bytes);
+    for (int64_t i = 0; i < (int64_t)n * n; i++) { x[i] = (fp32_t)(i % 3); }
+    blast.unmap(&ma);
+    x = (fp32_t*)blast.map(&mb, blast_access_write, 0, bytes);
+    for (int64_t i = 0; i < (int64_t)n * n; i++) { x[i] = (fp32_t)(i % 2); }
+    blast.unmap(&mb);
+    const blast_gemm_tile_t defaults = b->gemm_tile;
+    static const blast_gemm_tile_t tiles[] = {
+        {8, 16}, {8, 64}, {16, 64}, {16, 256}, {32, 64}, {32, 256}
+    };
+    const ocl_profiling_t* p = &b->c->ov->profiling[0];
+    traceln("gemm_fp32[%d] tile, items, groups, time (ms), GFlops", n);
+    for (int t = 0; t < countof(tiles); t++) {
+        b->gemm_tile = tiles[t];
+        b->gemm[blast_fpp32](&ma, 0, n, &mb, 0, n, &mc, 0, n, n, n, n);
+        const blast_launch_t* l = &b->launch;
+        traceln("%4lld, %5lld, %6lld, %10.3f, %7.3f", tiles[t].tile,
+                l->items, l->groups, p->time * MSEC_IN_SEC, p->gflops);
+    }
+    b->gemm_tile = defaults;
+    b->gemm_mixed(&ma, 0, n, &mb, 0, n, &mc, 0, n, n, n / 2, n / 2);
+    traceln("gemm_mixed[%dx%dx%d] %.3f (ms) GFlops: %7.3f", n, n / 2, n / 2,
+            p->time * MSEC_IN_SEC, p->gflops);
+    blast.deallocate(&mc);
+    blast.deallocate(&mb);
+    blast.deallocate(&ma);
+}
+
 static void test_dot_compare_gpu_avx(blast_t* b) {
     enum { n = 16 * 1024 * 1024 };
     test_dot_t td = test_dot_alloc(b, blast_fpp32, n, n);
@@ -187,6 +1141,273 @@ static void test_dot_compare_gpu_avx(blast_t* b) {
     test_dot_free(&td);
 }
 
+static void test_dot_reduce_vs_chain(blast_t* b) {
+    // single pass work-group reduction vs log2(n) sum_even/sum_odd chain
+    enum { n = 16 * 1024 * 1024 };
+    ocl_context_t* c = b->c;
+    test_dot_t td = test_dot_alloc(b, blast_fpp32, n, n);
+    test_dot_map(&td);
+    fp32_t* x = (fp32_t*)td.a0;
+    fp32_t* y = (fp32_t*)td.a1;
+    fp32_t delta = (fp32_t)(1.0 / (double)(1ULL << 63));
+    for (int64_t i = 0; i < n; i++) {
+        fp32_t sign = (i % 2 == 0 ? -1.0f : +1.f);
+        x[i] = 1.0f + sign * ((i + 1) * delta);
+        y[i] = 1.0f - sign * ((i + 1) * delta);
+        assert(x[i] * y[i] == 1.0f);
+    }
+    test_dot_unmap(&td);
+    traceln("Nx1000,   chain,  reduce, kernel: chain,  reduce (ms)");
+    for (int i = 1024; i <= n / 1024; i *= 2) {
+        double chain = seconds();
+        b->chain = true;
+        fp64_t sum0 = b->dot[blast_fpp32](&td.v0, 0, 1, &td.v1, 0, 1, i * 1024);
+        chain = seconds() - chain;
+        double chain_kernel = ocl.is_profiling(c) ? c->ov->profiling[0].time : 0;
+        double reduce = seconds();
+        b->chain = false;
+        fp64_t sum1 = b->dot[blast_fpp32](&td.v0, 0, 1, &td.v1, 0, 1, i * 1024);
+        reduce = seconds() - reduce;
+        double reduce_kernel = ocl.is_profiling(c) ? c->ov->profiling[0].time : 0;
+        traceln("%6d, %7.3f, %7.3f,         %7.3f, %7.3f", i,
+            chain * MSEC_IN_SEC, reduce * MSEC_IN_SEC,
+            chain_kernel * MSEC_IN_SEC, reduce_kernel * MSEC_IN_SEC);
+        fatal_if(sum0 != sum1 || sum1 != (fp64_t)i * 1024);
+    }
+    test_dot_free(&td);
+}
+
+static void test_dispatch(blast_t* b) {
+    // both paths and both residencies give the same exact results
+    enum { n = 4 * 1024 * 1024, m = 129, k = 257 };
+    dispatch_t d;
+    dispatch.init(&d, b, n);
+    dispatch.dump(&d);
+    blast_memory_t v0 = blast.allocate(b, blast_access_rw, k * sizeof(fp32_t));
+    blast_memory_t v1 = blast.allocate(b, blast_access_rw, k * sizeof(fp32_t));
+    blast_memory_t mx = blast.allocate(b, blast_access_rw,
+                                       m * k * sizeof(fp32_t));
+    blast_memory_t r  = blast.allocate(b, blast_access_rw, m * sizeof(fp32_t));
+    fp32_t* x = (fp32_t*)blast.map(&v0, blast_access_write, 0, v0.s);
+    fp32_t* y = (fp32_t*)blast.map(&v1, blast_access_write, 0, v1.s);
+    fp32_t* a = (fp32_t*)blast.map(&mx, blast_access_write, 0, mx.s);
+    fp64_t expected = 0;
+    fp64_t squares = 0;
+    for (int j = 0; j < k; j++) {
+        x[j] = (fp32_t)(j % 5);
+        y[j] = (fp32_t)(j % 3);
+        expected += x[j] * y[j];
+        squares  += x[j] * x[j];
+    }
+    for (int i = 0; i < m * k; i++) { a[i] = (fp32_t)(i % 7); }
+    blast.unmap(&mx);
+    blast.unmap(&v1);
+    blast.unmap(&v0);
+    for (int path = 0; path < 4; path++) {
+        const bool device = (path & 1) != 0;
+        const int residency = (path & 2) != 0 ? dispatch_host : dispatch_device;
+        for (int fpp = blast_fpp16; fpp <= blast_fpp64; fpp++) {
+            d.dot[fpp][residency]  = device ? 0 : dispatch_never;
+            d.gemv[fpp][residency] = device ? 0 : dispatch_never;
+        }
+        if (residency == dispatch_host) {
+            blast.map(&v0, blast_access_rw, 0, v0.s);
+            blast.map(&v1, blast_access_rw, 0, v1.s);
+            blast.map(&mx, blast_access_rw, 0, mx.s);
+            blast.map(&r,  blast_access_rw, 0, r.s);
+        }
+        fatal_if(dispatch.on_device(&d, false, blast_fpp32, residency, k) !=
+                 device);
+        fp64_t dot = dispatch.dot(&d, blast_fpp32, &v0, 0, 1, &v1, 0, 1, k);
+        fatal_if(dot != expected, "path: %d dot: %.7e != %.7e",
+                 path, dot, expected);
+        // separate struct over the same buffer has its own mapping
+        blast_memory_t w = blast.share(&v0, b);
+        if (residency == dispatch_host) {
+            blast.map(&w, blast_access_read, 0, w.s);
+        }
+        dot = dispatch.dot(&d, blast_fpp32, &v0, 0, 1, &w, 0, 1, k);
+        fatal_if(dot != squares, "path: %d dot: %.7e != %.7e",
+                 path, dot, squares);
+        if (residency == dispatch_host) {
+            fatal_if(v0.m == null || w.m == null, "not mapped back");
+            blast.unmap(&w);
+        }
+        dispatch.gemv(&d, blast_fpp32, &mx, 0, k, &v0, 0, 1, &r, m, k);
+        if (residency == dispatch_device) {
+            blast.map(&v0, blast_access_read, 0, v0.s);
+            blast.map(&mx, blast_access_read, 0, mx.s);
+            blast.map(&r,  blast_access_read, 0, r.s);
+        }
+        x = (fp32_t*)v0.m;
+        a = (fp32_t*)mx.m;
+        const fp32_t* z = (const fp32_t*)r.m;
+        for (int i = 0; i < m; i++) {
+            fp32_t e = 0;
+            for (int j = 0; j < k; j++) { e += a[i * k + j] * x[j]; }
+            fatal_if(z[i] != e, "path: %d r[%d]: %.7e != %.7e",
+                     path, i, z[i], e);
+        }
+        blast.unmap(&r);
+        blast.unmap(&mx);
+        blast.unmap(&v0);
+        if (residency == dispatch_host) { blast.unmap(&v1); }
+    }
+    blast.deallocate(&r);
+    blast.deallocate(&mx);
+    blast.deallocate(&v1);
+    blast.deallocate(&v0);
+}
+
+static void test_coexec(blast_t* b) {
+    // benchmark: CPU only, device only and co-executed dot() and gemv()
+    enum { n = 16 * 1024 * 1024, m = 4 * 1024 };
+    dispatch_t d;
+    dispatch.init(&d, b, 64 * 1024); // crossovers are not used here
+    dispatch.balance(&d, n);
+    blast_memory_t v0 = blast.allocate(b, blast_access_rw, n * sizeof(fp32_t));
+    blast_memory_t v1 = blast.allocate(b, blast_access_rw, n * sizeof(fp32_t));
+    blast_memory_t r  = blast.allocate(b, blast_access_rw, m * sizeof(fp32_t));
+    fp32_t* x = (fp32_t*)blast.map(&v0, blast_access_write, 0, v0.s);
+    fp32_t* y = (fp32_t*)blast.map(&v1, blast_access_write, 0, v1.s);
+    fp64_t expected = 0;
+    for (int64_t i = 0; i < n; i++) {
+        x[i] = (fp32_t)(i % 3) - 1.0f;
+        y[i] = (fp32_t)(i % 2);
+        expected += x[i] * y[i];
+    }
+    blast.unmap(&v1);
+    blast.unmap(&v0);
+    const double balanced[2] = {
+        d.share[blast_fpp32][0], d.share[blast_fpp32][1]
+    };
+    const double shares[3] = { 0, 1, -1 }; // -1: balanced
+    const char* labels[3] = { "cpu", "device", "split" };
+    for (int op = 0; op < 2; op++) {
+        double time[3];
+        for (int i = 0; i < 3; i++) {
+            d.share[blast_fpp32][op] = shares[i] < 0 ? balanced[op] : shares[i];
+            time[i] = DBL_MAX;
+            for (int repeat = 0; repeat < 5; repeat++) {
+                double t = seconds();
+                if (op == 0) {
+                    fp64_t dot = dispatch.dot_split(&d, blast_fpp32,
+                        &v0, 0, 1, &v1, 0, 1, n);
+                    fatal_if(dot != expected, "%s dot: %.7e != %.7e",
+                             labels[i], dot, expected);
+                } else { // v0 as matrix [m][m]
+                    dispatch.gemv_split(&d, blast_fpp32, &v0, 0, m,
+                                        &v1, 0, 1, &r, m, m);
+                }
+                time[i] = min(time[i], seconds() - t);
+            }
+            if (op == 1) {
+                fp32_t* z = (fp32_t*)blast.map(&r, blast_access_read, 0, r.s);
+                for (int64_t row = 0; row < m; row++) {
+                    fp32_t e = 0;
+                    for (int64_t j = 0; j < m; j++) {
+                        e += ((fp32_t)((row * m + j) % 3) - 1.0f) *
+                             (fp32_t)(j % 2);
+                    }
+                    fatal_if(z[row] != e, "%s r[%lld]: %.7e != %.7e",
+                             labels[i], row, z[row], e);
+                }
+                blast.unmap(&r);
+            }
+        }
+        const double best_single = min(time[0], time[1]);
+        traceln("%s fp32 %s cpu: %7.3f device: %7.3f split(%.2f): %7.3f (ms) "
+                "%s", ocl.devices[b->c->ix].name, op == 0 ? "dot " : "gemv",
+                time[0] * MSEC_IN_SEC, time[1] * MSEC_IN_SEC, balanced[op],
+                time[2] * MSEC_IN_SEC, time[2] < best_single ?
+                "split is faster" : "split is NOT faster");
+    }
+    blast.deallocate(&r);
+    blast.deallocate(&v1);
+    blast.deallocate(&v0);
+}
+
+static void test_profiler(int32_t d) {
+    // profiling[4] is too small for log2(n) chain kernels of a single dot:
+    // .profile_add() folds entries into profiling[0]. All runs enqueue
+    // more kernels than the profiler ring holds in flight.
+    enum { n = 1024 * 1024, runs = 128 };
+    static ocl_profiling_t p[4];
+    static ocl_profiler_t profiler;
+    static ocl_override_t ov = {
+        .profiling = p,
+        .max_profiling_count = countof(p),
+        .profiling_count = 0,
+        .profiler = &profiler
+    };
+    ocl_context_t c = ocl.open(d, &ov);
+    blast_t b = { 0 };
+    blast.init(&b, &c);
+    test_dot_t td = test_dot_alloc(&b, blast_fpp32, n, n);
+    test_dot_map(&td);
+    for (int64_t i = 0; i < n; i++) {
+        ((fp32_t*)td.a0)[i] = 1.0f;
+        ((fp32_t*)td.a1)[i] = 1.0f;
+    }
+    test_dot_unmap(&td);
+    b.chain = true;
+    for (int i = 0; i < runs; i++) {
+        fp64_t dot = b.dot[blast_fpp32](&td.v0, 0, 1, &td.v1, 0, 1, n);
+        fatal_if(dot != n, "dot: %.7e != %d", dot, n);
+        fatal_if(p[0].merged == 0, "profiling[] was not folded");
+    }
+    ocl.finish(&c);
+    ocl_kernel_stats_t s[ocl_profiler_kernels];
+    const int32_t k = ocl.stats(&c, s, countof(s));
+    int64_t total = 0;
+    traceln("%-24s  count      ema      p50      p99      max (us)", "kernel");
+    for (int32_t i = 0; i < k; i++) {
+        const ocl_stats_t* t = &s[i].time;
+        fatal_if(!(t->min <= t->p50 && t->p50 <= t->p99 && t->p99 <= t->max));
+        traceln("%-24s %6lld %8.3f %8.3f %8.3f %8.3f", s[i].name, s[i].count,
+            t->ema * USEC_IN_SEC, t->p50 * USEC_IN_SEC,
+            t->p99 * USEC_IN_SEC, t->max * USEC_IN_SEC);
+        total += s[i].count;
+    }
+    fatal_if(total <= ocl_profiler_ring, "total: %lld", total);
+    ocl_kernel_stats_t one = { 0 };
+    fatal_if(k > 0 && !ocl.stats_of(&c, s[0].name, &one));
+    fatal_if(one.count != s[0].count);
+    fatal_if(ocl.stats_of(&c, "no_such_kernel", &one));
+    ocl.stats_reset(&c);
+    fatal_if(ocl.stats_of(&c, s[0].name, &one) && one.count != 0);
+    // more distinct kernel names than kernels[] holds go to "other"
+    enum { names = ocl_profiler_kernels + 6 };
+    static char code[names * 64];
+    int pos = 0;
+    for (int i = 0; i < names; i++) {
+        pos += snprintf(code + pos, countof(code) - pos,
+            "__kernel void k%d(__global int* p) { p[0] = %d; }\n", i, i);
+    }
+    ocl_program_t program = ocl.compile_program(&c, code, strlen(code), null);
+    blast_memory_t m = blast.allocate(&b, blast_access_rw, sizeof(int32_t));
+    ocl_arg_t args[] = { {&m.h, sizeof(ocl_memory_t)} };
+    for (int i = 0; i < names; i++) {
+        char name[16];
+        snprintf(name, countof(name), "k%d", i);
+        ocl_kernel_t kernel = ocl.create_kernel(program, name);
+        ocl_event_t e = ocl.enqueue_range_kernel(&c, kernel, 1, 1,
+            countof(args), args);
+        ocl.release_event(e);
+        ocl.release_kernel(kernel);
+    }
+    ocl.finish(&c);
+    const int32_t all = ocl.stats(&c, s, countof(s));
+    fatal_if(all != ocl_profiler_kernels, "kernels: %d", all);
+    fatal_if(strcmp(s[all - 1].name, "other") != 0 || s[all - 1].count < 6,
+             "%s: %lld", s[all - 1].name, s[all - 1].count);
+    blast.deallocate(&m);
+    ocl.release_program(program);
+    test_dot_free(&td);
+    blast.fini(&b);
+    ocl.close(&c);
+}
+
 static void dot_tests() {
     dot_test();
     for (int d = 0; d < ocl.count; d++) {
@@ -200,6 +1421,20 @@ static void dot_tests() {
             blast_t b = { 0 };
             blast.init(&b, &c);
             test_permutations(&b);
+            test_dot_async(&b);
+            test_dot_batched(&b);
+            test_pool(&b);
+            test_wrap(&b);
+            test_view(&b);
+            test_svm(&b);
+            test_graph(&b);
+            test_graph_ops(&b);
+            test_threads(&b);
+            test_gemv(&b);
+            test_gemv_mixed(&b);
+            test_gemv_q(&b);
+            test_gemm(&b);
+            test_ndrange(&b);
             blast.fini(&b);
             ocl.close(&c);
         }
@@ -218,9 +1453,13 @@ static void dot_tests() {
         // because fp32 have 24 binary digits significand and 2^24 is 16M:
         // 16M is the largest number w/o losing precision
         enum { n = 16 * 1024 * 1024 };
+        test_tune(&b);
         test_performance(&b, n);
         traceln("dot_fp32 x %d: %7.3f user: %7.3f (ms) GFlops: %7.3f", n,
             p[0].time * MSEC_IN_SEC, p[0].user * MSEC_IN_SEC, p[0].gflops);
+        test_dot_scaling(&b);
+        test_gemv_performance(&b);
+        test_gemm_performance(&b);
         blast.fini(&b);
         ocl.close(&c);
     }
@@ -235,16 +1474,83 @@ static void dot_tests() {
         traceln("%s", ocl.devices[d].name);
         blast_t b = { 0 };
         blast.init(&b, &c);
+        test_dot_reduce_vs_chain(&b);
         test_dot_compare_gpu_avx(&b);
+        test_dispatch(&b);
+        test_coexec(&b);
         blast.fini(&b);
         ocl.close(&c);
+        test_profiler(d);
+    }
+}
+
+static void test_multi_run(blast_multi_t* mb) {
+    enum { n = 100003, rows = 333, columns = 256 };
+    static fp32_t x[n], y[n];
+    static fp32_t mx[rows * columns], v[columns], r[rows];
+    fp64_t expected = 0;
+    for (int64_t i = 0; i < n; i++) {
+        x[i] = (fp32_t)(i % 7);
+        y[i] = (fp32_t)(i % 3);
+        expected += x[i] * y[i];
+    }
+    for (int64_t i = 0; i < rows * columns; i++) { mx[i] = (fp32_t)(i % 5); }
+    for (int64_t j = 0; j < columns; j++) { v[j] = (fp32_t)(j % 2); }
+    blast_sharded_t s0 = blast_multi.shard(mb, blast_fpp32, x, n, 1);
+    blast_sharded_t s1 = blast_multi.shard(mb, blast_fpp32, y, n, 1);
+    fp64_t dot = blast_multi.dot(&s0, &s1);
+    fatal_if(dot != expected, "dot: %.7e != %.7e", dot, expected);
+    blast_multi.unshard(&s1);
+    blast_multi.unshard(&s0);
+    blast_sharded_t sm = blast_multi.shard(mb, blast_fpp32, mx, rows, columns);
+    blast_multi.gemv(&sm, v, r);
+    for (int64_t i = 0; i < rows; i++) {
+        fp32_t e = 0;
+        for (int64_t j = 0; j < columns; j++) { e += mx[i * columns + j] * v[j]; }
+        fatal_if(r[i] != e, "r[%lld]: %.7e != %.7e", i, r[i], e);
+    }
+    for (int i = 0; i < mb->count; i++) {
+        traceln("%-40s share: %5.1f%% rows: %lld",
+                ocl.devices[mb->c[i].ix].name, mb->share[i] * 100,
+                sm.from[i + 1] - sm.from[i]);
+    }
+    blast_multi.unshard(&sm);
+}
+
+static void test_multi() {
+    // sub-devices of the first partitionable (CPU) device or all devices
+    int32_t devices[blast_max_devices];
+    int32_t count = 0;
+    const int32_t enumerated = ocl.count;
+    for (int d = 0; d < enumerated && count == 0; d++) {
+        const int32_t first = ocl.count;
+        count = ocl.sub_devices(d, 2);
+        for (int i = 0; i < count; i++) { devices[i] = first + i; }
+    }
+    if (count == 0) {
+        for (int i = 0; i < min(enumerated, blast_max_devices); i++) {
+            devices[count++] = i;
+        }
     }
+    static blast_multi_t mb;
+    blast_multi.open(&mb, count, devices);
+    test_multi_run(&mb); // equal shares
+    blast_multi.calibrate(&mb);
+    test_multi_run(&mb); // measured shares
+    blast_multi.close(&mb);
 }
 
 int32_t main(int32_t argc, const char* argv[]) {
     (void)argc; (void)argv;
     ocl.init();
     dot_tests();
+    test_multi();
+    const ocl_cache_t* pc = &ocl.cache;
+    const int64_t programs = pc->hits + pc->misses;
+    traceln("program cache: %lld/%lld hits (%.1f%%) stale: %lld "
+            "build: %.3f load: %.3f saved: %.3f (sec)", pc->hits, programs,
+            programs > 0 ? pc->hits * 100.0 / programs : 0.0, pc->stale,
+            pc->build, pc->load, pc->saved);
     return 0;
 }
 